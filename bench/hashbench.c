@@ -0,0 +1,101 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * getclient() against the client list walk it replaced, for 1 to 10000
+ * managed windows on the fake desktop. Most lookups come from WinEvents of
+ * windows that aren't managed, so hits and misses are timed apart. Both
+ * lookups must agree on every HWND.
+ */
+#include "../dwm-win32.c"
+#include "../host/fakedesktop.h"
+
+#define LOOKUPS     1000000
+
+static const unsigned int counts[] = { 1, 10, 100, 1000, 10000 };
+static unsigned int rng = 1;
+static volatile UINT_PTR sink;
+
+static unsigned int
+xorshift(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+/* getclient() before the index */
+static Client *
+walkclient(HWND hwnd) {
+    for (Monitor *m = mons; m; m = m->next)
+        for (Client *c = m->clients; c; c = c->next)
+            if (c->hwnd == hwnd)
+                return c;
+    return NULL;
+}
+
+/* ns per lookup, the walk gets fewer lookups on long lists */
+static double
+timelookups(Client *(*lookup)(HWND), const HWND *hwnds, unsigned int n) {
+    LARGE_INTEGER start, end;
+    unsigned int i;
+
+    QueryPerformanceCounter(&start);
+    for (i = 0; i < n; i++)
+        sink += (UINT_PTR)lookup(hwnds[i]);
+    QueryPerformanceCounter(&end);
+    return (double)(end.QuadPart - start.QuadPart) / n;
+}
+
+int
+main(void) {
+    HWND *hits, *misses;
+    unsigned int i, k, n = 0, walks, bad = 0;
+    Client *c;
+
+    fakemonitor(0, 0, 1920, 1080);
+    fakestart();
+    if (!(hits = malloc(LOOKUPS * sizeof(HWND))) || !(misses = malloc(LOOKUPS * sizeof(HWND))))
+        return 1;
+
+    printf("%6s %12s %12s %12s %12s\n", "n", "hash hit", "walk hit", "hash miss", "walk miss");
+    for (k = 0; k < LENGTH(counts); k++) {
+        for (; n < counts[k]; n++)
+            fakeopen(L"Bench", L"bench", L"C:\\bench.exe", 100 + n);
+        fakesettle();
+
+        /* managed windows, and HWNDs of the same kind that aren't */
+        for (i = 0; i < LOOKUPS; i++) {
+            hits[i] = fakehwnd(xorshift() % fake.n);
+            misses[i] = fakehwnd(fake.n + xorshift() % (fake.n + 1));
+        }
+        for (i = 0; i < 10000; i++) {
+            if ((c = getclient(hits[i])) != walkclient(hits[i]) || !c)
+                bad++;
+            if (getclient(misses[i]) || walkclient(misses[i]))
+                bad++;
+        }
+        walks = LOOKUPS / n > 1000 ? LOOKUPS / n : 1000;
+        printf("%6u %10.1fns %10.1fns %10.1fns %10.1fns\n", n,
+               timelookups(getclient, hits, LOOKUPS), timelookups(walkclient, hits, walks),
+               timelookups(getclient, misses, LOOKUPS), timelookups(walkclient, misses, walks));
+    }
+
+    /* churn, the table must stay in step with the lists */
+    for (i = 0; i < 20000; i++) {
+        HWND hwnd = fakehwnd(xorshift() % fake.n);
+        if (getclient(hwnd) && fakew(hwnd)->alive)
+            fakedestroy(hwnd);
+        else
+            fakeopen(L"Bench", L"bench", L"C:\\bench.exe", 100);
+        if (i % 64 == 0)
+            fakesettle();
+    }
+    fakesettle();
+    for (i = 0; i < fake.n; i++)
+        if (getclient(fakehwnd(i)) != walkclient(fakehwnd(i)))
+            bad++;
+
+    cleanup();
+    if (bad)
+        printf("hashbench: %u lookups disagree with the list walk\n", bad);
+    return bad != 0;
+}
@@ -0,0 +1,221 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Host benchmark and golden output check of the layouts in layout.c.
+ *
+ *   layoutbench            time every layout for 1 to 10000 windows
+ *   layoutbench -g dir     write the golden rectangles to dir
+ *   layoutbench -c dir     compare the layouts against the golden files
+ *
+ * Allocations are counted by linking with -Wl,--wrap=malloc and friends,
+ * a layout is expected to make none.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../layout.h"
+
+#define LENGTH(x)   (sizeof x / sizeof x[0])
+#define BENCHNS     2000000     /* time spent on each case */
+#define MAXN        10000
+
+typedef struct {
+    const char *name;
+    LayoutFunc f;
+} Layout;
+
+typedef struct {
+    const char *name;
+    int w, h;
+} Screen;
+
+static const Layout layouts[] = {
+    { "tile",        tile },
+    { "monocle",     monocle },
+    { "bstack",      bstack },
+    { "gaplessgrid", gaplessgrid },
+    { "grid",        grid },
+    { "spiral",      spiral },
+    { "dwindle",     dwindle },
+};
+
+static const Screen screens[] = {
+    { "1080p",     1920, 1080 },
+    { "4k",        3840, 2160 },
+    { "ultrawide", 3440, 1440 },
+    { "portrait",  1080, 1920 },
+};
+
+/* window counts that are timed, and the ones kept in the golden files */
+static const unsigned int benchn[] = { 1, 2, 3, 4, 5, 8, 10, 20, 50, 100, 500, 1000, 5000, 10000 };
+static const unsigned int goldenn[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                        16, 17, 18, 19, 20, 50, 100 };
+
+static const int barheight = 20;
+static Rect rects[MAXN];
+static unsigned long allocs;
+static volatile int sink;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+
+void *
+__wrap_malloc(size_t size) {
+    allocs++;
+    return __real_malloc(size);
+}
+
+void *
+__wrap_calloc(size_t n, size_t size) {
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+void *
+__wrap_realloc(void *p, size_t size) {
+    allocs++;
+    return __real_realloc(p, size);
+}
+
+static double
+now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* The parameters dwm-win32 would pass for a screen with the bar on top. */
+static LayoutParams
+params(const Screen *s, unsigned int n) {
+    LayoutParams p;
+
+    p.area = (Rect){ 0, barheight, s->w, s->h - barheight };
+    p.n = n;
+    p.mfact = 0.55;
+    p.bw = 1;
+    p.gap = 6;
+    p.minh = barheight;
+    return p;
+}
+
+static void
+bench(void) {
+    unsigned int i, j, k, reps;
+    unsigned long a;
+    double start, ns;
+    LayoutParams p;
+
+    printf("%-12s %-10s %6s %12s %8s\n", "layout", "screen", "n", "ns/arrange", "allocs");
+    for (i = 0; i < LENGTH(layouts); i++) {
+        for (j = 0; j < LENGTH(screens); j++) {
+            for (k = 0; k < LENGTH(benchn); k++) {
+                p = params(&screens[j], benchn[k]);
+                a = allocs;
+                reps = 0;
+                start = now();
+                do {
+                    layoutrects(layouts[i].f, &p, rects);
+                    sink += rects[p.n - 1].x;
+                    reps++;
+                } while ((ns = now() - start) < BENCHNS);
+                printf("%-12s %-10s %6u %12.1f %8.2f\n", layouts[i].name, screens[j].name,
+                       p.n, ns / reps, (double)(allocs - a) / reps);
+            }
+        }
+    }
+}
+
+static void
+golden(const Layout *l, FILE *f) {
+    unsigned int j, k, i;
+    LayoutParams p;
+
+    for (j = 0; j < LENGTH(screens); j++) {
+        for (k = 0; k < LENGTH(goldenn); k++) {
+            p = params(&screens[j], goldenn[k]);
+            layoutrects(l->f, &p, rects);
+            fprintf(f, "# %s %u\n", screens[j].name, p.n);
+            for (i = 0; i < p.n; i++)
+                fprintf(f, "%d %d %d %d\n", rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+        }
+    }
+}
+
+static FILE *
+goldenfile(const char *dir, const Layout *l, const char *mode) {
+    char path[4096];
+    FILE *f;
+
+    snprintf(path, sizeof path, "%s/%s.txt", dir, l->name);
+    if (!(f = fopen(path, mode)))
+        perror(path);
+    return f;
+}
+
+static int
+writegolden(const char *dir) {
+    unsigned int i;
+    FILE *f;
+
+    for (i = 0; i < LENGTH(layouts); i++) {
+        if (!(f = goldenfile(dir, &layouts[i], "w")))
+            return 1;
+        golden(&layouts[i], f);
+        fclose(f);
+    }
+    return 0;
+}
+
+/* Reports the first line of each layout that differs from its golden file,
+ * with the screen and window count it belongs to. */
+static int
+checkgolden(const char *dir) {
+    char want[256], got[256], where[256] = "";
+    unsigned int i, line, failed = 0;
+    FILE *f, *out;
+    char *w, *g;
+
+    for (i = 0; i < LENGTH(layouts); i++) {
+        if (!(f = goldenfile(dir, &layouts[i], "r")) || !(out = tmpfile()))
+            return 1;
+        golden(&layouts[i], out);
+        rewind(out);
+        for (line = 1; ; line++) {
+            w = fgets(want, sizeof want, f);
+            g = fgets(got, sizeof got, out);
+            if (!w && !g)
+                break;
+            if (!w || !g || strcmp(want, got)) {
+                printf("%s/%s.txt:%u: %s: want %s, got %s\n", dir, layouts[i].name, line,
+                       where, w ? strtok(want, "\n") : "end of file", g ? strtok(got, "\n") : "end of output");
+                failed++;
+                break;
+            }
+            if (got[0] == '#')
+                snprintf(where, sizeof where, "%s", strtok(got + 2, "\n"));
+        }
+        fclose(out);
+        fclose(f);
+    }
+    printf("layoutbench: %u of %u layouts match the golden files\n",
+           (unsigned)LENGTH(layouts) - failed, (unsigned)LENGTH(layouts));
+    return failed != 0;
+}
+
+int
+main(int argc, char *argv[]) {
+    if (argc == 3 && !strcmp(argv[1], "-g"))
+        return writegolden(argv[2]);
+    if (argc == 3 && !strcmp(argv[1], "-c"))
+        return checkgolden(argv[2]);
+    if (argc != 1) {
+        fprintf(stderr, "usage: layoutbench [-g dir | -c dir]\n");
+        return 2;
+    }
+    bench();
+    return 0;
+}
@@ -0,0 +1,312 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Plays a log written by dwm-win32 -r back on the fake desktop and times
+ * it, per kind of event and in the batches that handle them.
+ *
+ *   replay file
+ *
+ * Windows are made from the snapshots in the log, their WinEvents go to
+ * wineventproc() and the rest to WndProc(), as they arrived. Events are
+ * handled in a batch wherever the log has a quiet period, like the message
+ * loop does once its queue runs dry. Windows that were open before the
+ * recording started are unknown until they are renamed or shown again.
+ * There is one 1920x1080 monitor, the log doesn't say which there were.
+ */
+#include <stdint.h>
+
+#include "../dwm-win32.c"
+#include "../host/fakedesktop.h"
+
+#define QUIET       1       /* ms between records that ends a batch */
+#define UNKNOWN     ((HWND)(UINT_PTR)1)     /* never a fake window */
+#define MAXSTATS    256
+
+/* RecWindow as written on Windows, where wchar_t has 16 bits */
+typedef struct {
+    DWORD pid;
+    DWORD style, exstyle;
+    RECT rect;
+    uint16_t classname[64];
+    uint16_t title[64];
+} DiskWindow;
+
+typedef struct {
+    ULONGLONG hwnd;         /* in the log, 0 is a free slot */
+    HWND fake;
+} Mapping;
+
+/* time spent on the records of one kind and code */
+typedef struct {
+    DWORD kind, code;
+    unsigned long n;
+    LONGLONG total, max;
+} Stat;
+
+static const char *kindnames[] = {
+    [RecShell] = "shell", [RecWinEvent] = "winevent", [RecHotkey] = "hotkey", [RecDisplay] = "display",
+};
+
+static const struct {
+    DWORD code;
+    const char *name;
+} eventnames[] = {
+    { EVENT_OBJECT_CREATE,          "CREATE" },
+    { EVENT_OBJECT_DESTROY,         "DESTROY" },
+    { EVENT_OBJECT_SHOW,            "SHOW" },
+    { EVENT_OBJECT_HIDE,            "HIDE" },
+    { EVENT_OBJECT_NAMECHANGE,      "NAMECHANGE" },
+    { EVENT_OBJECT_LOCATIONCHANGE,  "LOCATIONCHANGE" },
+    { EVENT_OBJECT_CLOAKED,         "CLOAKED" },
+    { EVENT_OBJECT_UNCLOAKED,       "UNCLOAKED" },
+    { EVENT_SYSTEM_MINIMIZESTART,   "MINIMIZESTART" },
+    { EVENT_SYSTEM_MINIMIZEEND,     "MINIMIZEEND" },
+    { EVENT_SYSTEM_FOREGROUND,      "FOREGROUND" },
+};
+
+static Mapping *map;
+static unsigned int mapcap, maplen;
+static Stat stats[MAXSTATS], batchstat;
+static unsigned int nstats;
+
+static unsigned int
+maphash(ULONGLONG hwnd) {
+    return (unsigned int)((hwnd >> 2) * 2654435761u) & (mapcap - 1);
+}
+
+static Mapping *
+mapslot(ULONGLONG hwnd) {
+    unsigned int i;
+
+    for (i = maphash(hwnd); map[i].hwnd && map[i].hwnd != hwnd; i = (i + 1) & (mapcap - 1));
+    return &map[i];
+}
+
+static void
+mapset(ULONGLONG hwnd, HWND fake) {
+    Mapping *old = map, *m;
+    unsigned int i, cap = mapcap;
+
+    if (2 * (maplen + 1) > mapcap) {
+        mapcap = mapcap ? mapcap * 2 : 256;
+        if (!(map = calloc(mapcap, sizeof(Mapping))))
+            die(L"replay: could not calloc() %u bytes\n", mapcap * (unsigned)sizeof(Mapping));
+        for (i = 0; i < cap; i++)
+            if (old[i].hwnd)
+                *mapslot(old[i].hwnd) = old[i];
+        free(old);
+    }
+    if (!(m = mapslot(hwnd))->hwnd)
+        maplen++;
+    m->hwnd = hwnd;
+    m->fake = fake;
+}
+
+static HWND
+mapget(ULONGLONG hwnd) {
+    Mapping *m;
+
+    if (!mapcap || !hwnd)
+        return hwnd ? UNKNOWN : NULL;
+    m = mapslot(hwnd);
+    return m->hwnd ? m->fake : UNKNOWN;
+}
+
+static void
+widen(wchar_t *dst, const uint16_t *src, unsigned int len) {
+    unsigned int i;
+
+    for (i = 0; i < len - 1 && src[i]; i++)
+        dst[i] = src[i];
+    dst[i] = L'\0';
+}
+
+/* The window the snapshot shows, a new one unless hwnd is still alive. */
+static HWND
+snapshot(ULONGLONG hwnd, const DiskWindow *d) {
+    wchar_t classname[64], title[64];
+    HWND h = mapget(hwnd);
+    FakeWindow *w;
+
+    widen(classname, d->classname, LENGTH(classname));
+    widen(title, d->title, LENGTH(title));
+    if (!(w = fakew(h)) || !w->alive) {
+        h = fakewindow(classname, title, NULL, d->pid, d->rect);
+        mapset(hwnd, h);
+        w = fakew(h);
+    }
+    fakestring(title, w->title, (int)LENGTH(w->title));
+    w->style = (LONG)d->style;
+    w->exstyle = (LONG)d->exstyle;
+    w->rect = d->rect;
+    w->visible = (d->style & WS_VISIBLE) != 0;
+    return h;
+}
+
+/* What the event tells about the window, before dwm-win32 looks at it. */
+static void
+apply(DWORD event, HWND hwnd) {
+    FakeWindow *w = fakew(hwnd);
+
+    if (!w)
+        return;
+    switch (event) {
+    case EVENT_OBJECT_SHOW:         w->visible = true; break;
+    case EVENT_OBJECT_HIDE:         w->visible = false; break;
+    case EVENT_OBJECT_CLOAKED:      w->cloaked = true; break;
+    case EVENT_OBJECT_UNCLOAKED:    w->cloaked = false; break;
+    case EVENT_OBJECT_DESTROY:
+        w->alive = w->visible = false;
+        if (fake.foreground == hwnd)
+            fake.foreground = NULL;
+        break;
+    }
+}
+
+static double
+ms(LONGLONG ticks, LONGLONG freq) {
+    return freq ? 1e3 * ticks / freq : 0;
+}
+
+static void
+addtime(Stat *s, LONGLONG ticks) {
+    s->n++;
+    s->total += ticks;
+    if (ticks > s->max)
+        s->max = ticks;
+}
+
+static Stat *
+findstat(DWORD kind, DWORD code) {
+    unsigned int i;
+
+    for (i = 0; i < nstats && (stats[i].kind != kind || stats[i].code != code); i++);
+    if (i == nstats) {
+        if (nstats == MAXSTATS)
+            die(L"replay: more than %u kinds of records\n", MAXSTATS);
+        stats[nstats].kind = kind;
+        stats[nstats++].code = code;
+    }
+    return &stats[i];
+}
+
+static int
+statcmp(const void *a, const void *b) {
+    const Stat *x = a, *y = b;
+
+    if (x->kind != y->kind)
+        return x->kind < y->kind ? -1 : 1;
+    return x->code < y->code ? -1 : x->code > y->code;
+}
+
+static void
+printstat(const char *name, const Stat *s, LONGLONG freq) {
+    printf("%-26s %8lu %10.2f %10.2f\n", name, s->n,
+           s->n ? 1e3 * ms(s->total, freq) / s->n : 0, 1e3 * ms(s->max, freq));
+}
+
+static void
+printstats(LONGLONG freq) {
+    char name[64];
+    unsigned int i, k;
+    const char *kind;
+
+    qsort(stats, nstats, sizeof(Stat), statcmp);
+    printf("%-26s %8s %10s %10s\n", "record", "count", "mean us", "max us");
+    for (i = 0; i < nstats; i++) {
+        kind = stats[i].kind < LENGTH(kindnames) ? kindnames[stats[i].kind] : "unknown";
+        for (k = 0; stats[i].kind == RecWinEvent && k < LENGTH(eventnames)
+             && eventnames[k].code != stats[i].code; k++);
+        if (stats[i].kind == RecWinEvent && k < LENGTH(eventnames))
+            snprintf(name, sizeof(name), "%s %s", kind, eventnames[k].name);
+        else
+            snprintf(name, sizeof(name), "%s 0x%lx", kind, (unsigned long)stats[i].code);
+        printstat(name, &stats[i], freq);
+    }
+    printstat("batch", &batchstat, freq);
+}
+
+int
+main(int argc, char *argv[]) {
+    RecHeader h;
+    Record r = { 0 }, next;
+    DiskWindow d;
+    LARGE_INTEGER start, end, freq;
+    LONGLONG worst = 0, worstt = 0, first = 0;
+    unsigned long nrecs = 0;
+    unsigned int batches;
+    bool more;
+    HWND hwnd;
+    FILE *f;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: replay file\n");
+        return 2;
+    }
+    if (!(f = fopen(argv[1], "rb"))) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != RECMAGIC || h.version != RECVERSION) {
+        fprintf(stderr, "replay: %s is not a version %d dwm-win32 log\n", argv[1], RECVERSION);
+        return 1;
+    }
+
+    QueryPerformanceFrequency(&freq);
+    fakemonitor(0, 0, 1920, 1080);
+    fake.insets = (RECT){ 7, 0, 7, 7 };
+    fakestart();
+    batches = events.batches;
+
+    for (more = fread(&next, sizeof(next), 1, f) == 1; more; ) {
+        r = next;
+        if (!nrecs++)
+            first = r.t;
+        if (r.snapshot && fread(&d, sizeof(d), 1, f) != 1) {
+            fprintf(stderr, "replay: %s: snapshot of record %lu cut short\n", argv[1], nrecs);
+            break;
+        }
+        hwnd = r.snapshot ? snapshot(r.hwnd, &d) : mapget(r.hwnd);
+
+        QueryPerformanceCounter(&start);
+        switch (r.kind) {
+        case RecWinEvent:
+            apply(r.code, hwnd);
+            fakeevent(r.code, hwnd);
+            break;
+        case RecShell:
+            if (r.code == HSHELL_WINDOWACTIVATED)
+                fake.foreground = hwnd;
+            fakeshell(r.code, hwnd);
+            break;
+        case RecHotkey:
+            WndProc(dwmhwnd, WM_HOTKEY, r.code, 0);
+            break;
+        case RecDisplay:
+            WndProc(dwmhwnd, r.code, 0, 0);
+            break;
+        }
+        QueryPerformanceCounter(&end);
+        addtime(findstat(r.kind, r.code), end.QuadPart - start.QuadPart);
+
+        /* the queue runs dry in the pauses of the log */
+        more = fread(&next, sizeof(next), 1, f) == 1;
+        if (!more || ms(next.t - r.t, h.freq) >= (eventdelay ? eventdelay : QUIET)) {
+            QueryPerformanceCounter(&start);
+            fakesettle();
+            QueryPerformanceCounter(&end);
+            addtime(&batchstat, end.QuadPart - start.QuadPart);
+            if (end.QuadPart - start.QuadPart > worst) {
+                worst = end.QuadPart - start.QuadPart;
+                worstt = r.t - first;
+            }
+        }
+    }
+    fclose(f);
+
+    printf("%lu records over %.1fms, %u windows, %u managed at the end, %u batches, %lu placements\n",
+           nrecs, ms(r.t - first, h.freq), fake.n, chashlen, events.batches - batches, fake.placed);
+    printstats(freq.QuadPart);
+    printf("slowest batch at %.1fms\n", ms(worstt, h.freq));
+    cleanup();
+    return 0;
+}
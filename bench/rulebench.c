@@ -0,0 +1,124 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * applyrules() with config.def.h's rules and 1000 more against the wcsstr()
+ * loop over every rule it replaced, see bench/ruleconfig.h. Windows with and
+ * without a matching rule are timed apart, both must come out with the same
+ * tags, floating and border.
+ */
+#define CONFIG "bench/ruleconfig.h"
+#include "../dwm-win32.c"
+#include "../host/fakedesktop.h"
+
+#define NCLIENTS    1000
+#define ROUNDS      20
+
+static unsigned int rng = 1;
+
+static unsigned int
+xorshift(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+/* applyrules() before the automaton, with the process field added */
+static void
+naiverules(Client *c) {
+    unsigned int i;
+    Rule *r;
+
+    for (i = 0; i < LENGTH(rules); i++) {
+        r = &rules[i];
+        if ((!r->title || wcsstr(c->title, r->title))
+        && (!r->class || wcsstr(c->classname, r->class))
+        && (!r->process || (c->processname && wcsstr(c->processname, r->process)))) {
+            c->isfloating = r->isfloating;
+            c->ignoreborder = r->ignoreborder;
+            c->tags |= r->tags & TAGMASK ? r->tags & TAGMASK : tagset[seltags];
+        }
+    }
+    if (!c->tags)
+        c->tags = tagset[seltags];
+}
+
+/* Windows as they show up on a desktop, if match is set most of them are
+ * hit by one of the generated rules. */
+static void
+makeclients(Client *cs, wchar_t (*images)[MAX_PATH], bool match) {
+    static const wchar_t *classes[] = { L"Chrome_WidgetWin_1", L"ConsoleWindowClass", L"Notepad",
+                                        L"CabinetWClass", L"rctrl_renwnd32", L"SunAwtFrame" };
+    static const wchar_t *titles[] = { L"New Tab - Google Chrome", L"C:\\Windows\\system32\\cmd.exe",
+                                       L"notes.txt - Notepad", L"Downloads", L"Inbox - Outlook",
+                                       L"Project - src/main/java/App.java - IntelliJ IDEA" };
+    unsigned int i, k;
+
+    for (i = 0; i < NCLIENTS; i++) {
+        k = xorshift();
+        memset(&cs[i], 0, sizeof(Client));
+        if (match && k % 4 == 0)
+            swprintf(cs[i].classname, LENGTH(cs[i].classname), L"Class%u", 100 + k / 4 % 400);
+        else
+            wcscpy(cs[i].classname, classes[k % LENGTH(classes)]);
+        if (match && k % 4 == 1)
+            swprintf(cs[i].title, LENGTH(cs[i].title), L"Title %u - Editor", 500 + k / 4 % 200);
+        else if (match && k % 4 == 3)
+            swprintf(cs[i].title, LENGTH(cs[i].title), L"Doc %u", 900 + k / 4 % 200);
+        else
+            wcscpy(cs[i].title, titles[k / 7 % LENGTH(titles)]);
+        if (match && k % 4 == 3)
+            swprintf(cs[i].classname, LENGTH(cs[i].classname), L"Class%u", 900 + k / 4 % 200);
+        if (match && k % 4 == 2)
+            swprintf(images[i], MAX_PATH, L"C:\\Program Files\\app%u.exe", 700 + k / 4 % 200);
+        else
+            swprintf(images[i], MAX_PATH, L"C:\\Windows\\System32\\%ls.exe", classes[k / 11 % LENGTH(classes)]);
+        cs[i].processname = images[i];
+    }
+}
+
+/* ns per window */
+static double
+timerules(void (*apply)(Client *), Client *cs) {
+    LARGE_INTEGER start, end;
+    unsigned int i, r;
+
+    QueryPerformanceCounter(&start);
+    for (r = 0; r < ROUNDS; r++) {
+        for (i = 0; i < NCLIENTS; i++) {
+            cs[i].tags = 0;
+            apply(&cs[i]);
+        }
+    }
+    QueryPerformanceCounter(&end);
+    return (double)(end.QuadPart - start.QuadPart) / (ROUNDS * NCLIENTS);
+}
+
+int
+main(void) {
+    static Client cs[NCLIENTS], want[NCLIENTS];
+    static wchar_t images[NCLIENTS][MAX_PATH];
+    unsigned int i, m, bad = 0;
+    double fast, slow;
+
+    fakemonitor(0, 0, 1920, 1080);
+    memcpy(&rules[LENGTH(rules) - LENGTH(defrules)], defrules, sizeof(defrules));
+    fakestart();
+    printf("%u rules, %u trie nodes\n", (unsigned)LENGTH(rules), nrulenodes);
+    printf("%-8s %14s %14s %8s\n", "windows", "applyrules", "wcsstr loop", "speedup");
+    for (m = 0; m < 2; m++) {
+        makeclients(cs, images, m);
+        memcpy(want, cs, sizeof cs);
+        fast = timerules(applyrules, cs);
+        slow = timerules(naiverules, want);
+        for (i = 0; i < NCLIENTS; i++)
+            if (cs[i].tags != want[i].tags || cs[i].isfloating != want[i].isfloating
+            || cs[i].ignoreborder != want[i].ignoreborder)
+                bad++;
+        printf("%-8s %12.1fns %12.1fns %7.1fx\n", m ? "matched" : "other", fast, slow, slow / fast);
+    }
+
+    cleanup();
+    if (bad)
+        printf("rulebench: %u windows disagree with the wcsstr loop\n", bad);
+    return bad != 0;
+}
@@ -0,0 +1,21 @@
+/* config.def.h with 1000 generated rules in front of its own, a quarter of
+ * them with two patterns. rulebench copies its own into the room left at
+ * the end before setup(). */
+#define rules defrules
+#include "../config.def.h"
+#undef rules
+
+#define RC(n)   { L"Class" #n,  NULL,           1 << 1, false,  false,  NULL },
+#define RT(n)   { NULL,         L"Title " #n,   1 << 2, true,   false,  NULL },
+#define RP(n)   { NULL,         NULL,           1 << 3, false,  true,   L"\\app" #n ".exe" },
+#define RCT(n)  { L"Class" #n,  L"Doc " #n,     1 << 4, true,   true,   NULL },
+#define R10(r, n)   r(n##0) r(n##1) r(n##2) r(n##3) r(n##4) r(n##5) r(n##6) r(n##7) r(n##8) r(n##9)
+#define R100(r, n)  R10(r, n##0) R10(r, n##1) R10(r, n##2) R10(r, n##3) R10(r, n##4) \
+                    R10(r, n##5) R10(r, n##6) R10(r, n##7) R10(r, n##8) R10(r, n##9)
+
+static Rule rules[1000 + LENGTH(defrules)] = {
+    R100(RC, 1) R100(RC, 2) R100(RC, 3) R100(RC, 4)
+    R100(RT, 5) R100(RT, 6)
+    R100(RP, 7) R100(RP, 8)
+    R100(RCT, 9) R100(RCT, 10)
+};
@@ -13,36 +13,41 @@ static const unsigned int fontsize  = 16;
 #define selfgcolor      0x00eeeeee
 
 static const unsigned int borderpx    = 0;        /* border pixel of windows */
+static const int gappx                = 0;        /* gap pixel between and around tiled windows */
 static const unsigned int textmargin  = 15;       /* margin for the text displayed on the bar */
 static bool showbar                   = true;     /* false means no bar */
 static bool topbar                    = true;     /* false means bottom bar */
 static bool roundcorners              = false;    /* false means no round corners (Windows 11) */
 static bool focusonclick              = true;
 static bool showexploreronstart       = false;    /* false means do not show explorer/task bar on start */
+static const unsigned int eventdelay  = 0;        /* ms without window events before a burst is handled, 0 means once the message queue is empty */
+static const wchar_t *cmdpipe         = NULL;     /* named pipe taking commands, e.g. L"\\\\.\\pipe\\dwm-win32", NULL means none */
+static const wchar_t *statusfeed      = NULL;     /* pipe or file status lines are read from, e.g. L"\\\\.\\pipe\\dwm-win32-status", NULL means none */
+static const unsigned int statuspoll  = 500;      /* ms between checks of a status file */
 
 /* tagging */
 static const wchar_t tags[][MAXTAGLEN] = { L"1", L"2", L"3", L"4", L"5", L"6", L"7", L"8", L"9" };
 static unsigned int tagset[] = {1, 1}; /* after start, first tag is selected */
 
 static Rule rules[] = {
-    /* class                                title                                   tags mask   isfloating      ignoreborder */
-    { L"MultitaskingViewFrame",              NULL,                                   0,          true,           true },
-    { L"MSCTFIME UI",                        NULL,                                   0,          true,           true },
-    { L"Microsoft-Windows-SnipperToolbar",   L"Snipping Tool",                       0,          true,           true },
-    { L"Microsoft Text Input Application",   NULL,                                   0,          true,           true },
-    { L"MSO_BORDEREFFECT_WINDOW_CLASS",      NULL,                                   0,          true,           true },
-    { L"CASCADIA_HOSTING_WINDOW_CLASS",      NULL,                                   0,          false,          true },
-    { L"ThumbnailDeviceHelperWnd",           NULL,                                   0,          true,           true },
-    { L"EdgeUiInputTopWndClass",             NULL,                                   0,          true,           true },
-    { L"CabinetWClass",                      NULL,                                   0,          false,          true }, /* file explorer */
-    { L"XLMAIN",                             NULL,                                   0,          false,          true }, /* Excel */
-    { NULL,                                  L"MSO_BORDEREFFECT_WINDOW_CLASS",       0,          false,          true }, /* Excel */
-    { L"PPTFrameClass",                      NULL,                                   0,          false,          true }, /* PowerPoint */
-    { L"OpusApp",                            NULL,                                   0,          false,          true }, /* Word */
-    { NULL,                                  L"OneNote",                             0,          false,          true }, /* OneNote */
-    { NULL,                                  L"Snip & Sketch",                       0,          true,           true },
-    { L"Chrome_WidgetWin_1",                 L"Google Chrome",                       0,          false,          true },
-    { NULL,                                  L"vimrun.exe",                          0,          true,           true },
+    /* class                                title                                   tags mask   isfloating      ignoreborder    process */
+    { L"MultitaskingViewFrame",              NULL,                                   0,          true,           true,           NULL },
+    { L"MSCTFIME UI",                        NULL,                                   0,          true,           true,           NULL },
+    { L"Microsoft-Windows-SnipperToolbar",   L"Snipping Tool",                       0,          true,           true,           NULL },
+    { L"Microsoft Text Input Application",   NULL,                                   0,          true,           true,           NULL },
+    { L"MSO_BORDEREFFECT_WINDOW_CLASS",      NULL,                                   0,          true,           true,           NULL },
+    { L"CASCADIA_HOSTING_WINDOW_CLASS",      NULL,                                   0,          false,          true,           NULL },
+    { L"ThumbnailDeviceHelperWnd",           NULL,                                   0,          true,           true,           NULL },
+    { L"EdgeUiInputTopWndClass",             NULL,                                   0,          true,           true,           NULL },
+    { L"CabinetWClass",                      NULL,                                   0,          false,          true,           NULL }, /* file explorer */
+    { L"XLMAIN",                             NULL,                                   0,          false,          true,           NULL }, /* Excel */
+    { NULL,                                  L"MSO_BORDEREFFECT_WINDOW_CLASS",       0,          false,          true,           NULL }, /* Excel */
+    { L"PPTFrameClass",                      NULL,                                   0,          false,          true,           NULL }, /* PowerPoint */
+    { L"OpusApp",                            NULL,                                   0,          false,          true,           NULL }, /* Word */
+    { NULL,                                  L"OneNote",                             0,          false,          true,           NULL }, /* OneNote */
+    { NULL,                                  L"Snip & Sketch",                       0,          true,           true,           NULL },
+    { L"Chrome_WidgetWin_1",                 L"Google Chrome",                       0,          false,          true,           NULL },
+    { NULL,                                  L"vimrun.exe",                          0,          true,           true,           NULL },
 };
 
 /* layout(s) */
@@ -83,6 +88,9 @@ static Key keys[] = {
     { MODKEY,                       'H',            setmfact,            {.f = -0.05} },
     { MODKEY,                       'L',            setmfact,            {.f = +0.05} },
     { MODKEY,                       'I',            showclientinfo,      {0} },
+    { MODKEY|MOD_SHIFT,             'I',            showprofile,         {0} },
+    { MODKEY|MOD_CONTROL,           'I',            dumpprofile,         {.v = L"dwm-win32-profile.txt"} },
+    { MODKEY|MOD_CONTROL,           'T',            toggletrace,         {.v = L"dwm-win32-trace.json"} },
     { MODKEY|MOD_CONTROL,           VK_RETURN,      zoom,                {0} },
     { MODKEY,                       VK_TAB,         view,                {0} },
     { MODKEY|MOD_SHIFT,             'C',            killclient,          {0} },
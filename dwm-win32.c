@@ -33,9 +33,11 @@
 #include <shellapi.h>
 #include <stdbool.h>
 
+#include "layout.h"
+
 #define NAME                    L"dwm-win32"     /* Used for window name/class */
 
-#define ISFOCUSABLE(x)          (!(x)->isminimized && ISVISIBLE(x) && IsWindowVisible((x)->hwnd))
+#define ISFOCUSABLE(x)          (!(x)->isminimized && ISVISIBLE(x) && pf->visible((x)->hwnd))
 #define LENGTH(x)               (sizeof x / sizeof x[0])
 #define MAX(a, b)               ((a) > (b) ? (a) : (b))
 #define MIN(a, b)               ((a) < (b) ? (a) : (b))
@@ -44,22 +46,78 @@
 #define HEIGHT(x)               ((x)->h + 2 * (x)->bw)
 #define TAGMASK                 ((int)((1LL << LENGTH(tags)) - 1))
 #define TEXTW(x)                (textnw(x, wcslen(x)))
-
+#define CACHELINE               64
+#define SLABSIZE                (64 * 1024)     /* VirtualAlloc() granularity */
+#define POISON                  0xDB
+#define NWORKERS                2               /* threads gathering window metadata */
+#define EVENTTIMER              1               /* dwmhwnd timer ending an event burst */
+#define WM_PIPECOMMAND          (WM_APP + 1)    /* lParam is a Command from the pipe thread */
+#define WM_STATUSFEED           (WM_APP + 2)    /* the status feed has a new line */
+#define STATUSTIMER             2               /* dwmhwnd timer holding back a status update */
+#define CMDSIZE                 4096            /* longest request or reply on the pipe */
+#define CMDMAX                  64              /* commands in one request */
+#define RECMAGIC                0x524d5744      /* "DWMR", start of a -r log */
+#define RECVERSION              1
+
+/* tested here, before config.h defines DEBUG for every build */
 #ifdef DEBUG
 #define debug(...) eprint(false, __VA_ARGS__)
+#define POOLDEBUG               /* poison freed pool slots, check them on reuse */
 #else
 #define debug(...) do { } while (false)
 #endif
 
+#ifdef PROFILE
+#define PROFSTART(t) LONGLONG t = profnow()
+#define PROFEND(h, t) histadd(h, profnow() - (t))
+#else
+#define PROFSTART(t) do { } while (false)
+#define PROFEND(h, t) do { } while (false)
+#endif
+#define TRACESTART(t) LONGLONG t = tracing ? profnow() : 0
+#define TRACEEND(t, ...) do { if (t) traceend(t, __VA_ARGS__); } while (false)
+#define TRACESPANS              16384           /* ring of recent spans, a power of two */
+#define HISTSUB                 8               /* linear steps per power of two */
+#define HISTBUCKETS             (64 * HISTSUB)
+
 #define die(...) if (TRUE) { eprint(true, __VA_ARGS__); eprint(true, L"Win32 Last Error: %d", GetLastError()); cleanup(); exit(EXIT_FAILURE); }
 
+#define EVENT_OBJECT_CLOAKED 0x8017
 #define EVENT_OBJECT_UNCLOAKED 0x8018
 
 enum { CurNormal, CurResize, CurMove, CurLast };        /* cursor */
 enum { ColBorder, ColFG, ColBG, ColLast };              /* color */
 enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle };    /* clicks */
+enum { SegTags, SegLayout, SegStatus, SegTitle, SegLast };      /* bar segments */
+enum { RuleClass, RuleTitle, RuleProcess, RuleLast };          /* rule fields */
+enum { DirtyLayout = 1, DirtyVisibility = 2, DirtyBar = 4,
+       DirtyAll = 7 };                                          /* pending monitor work */
+enum { EvCreated = 1, EvDestroyed = 2, EvActivated = 4, EvHidden = 8,
+       EvName = 16, EvCloaked = 32, EvUncloaked = 64, EvMinimized = 128,
+       EvRestored = 256, EvMoved = 512 };                       /* window events */
+enum { RecShell, RecWinEvent, RecHotkey, RecDisplay };          /* recorded events */
+enum { StatusNorm, StatusSel, StatusInvert };                   /* status text colors */
+enum { ProfClose, ProfEventTimer, ProfDisplay, ProfShell, ProfWinEvent,
+       ProfBarPaint, ProfBar, ProfEvents, ProfQueries, ProfCommand,
+       ProfStatus, ProfOther, ProfLast };  /* profiled handlers */
 
 typedef struct Monitor Monitor;
+typedef struct Layout Layout;
+
+/* Fixed size records are carved out of 64 KiB slabs in cache line aligned
+ * slots. Freed slots are recycled through a free list threaded through them. */
+typedef struct {
+    size_t size;            /* slot size, a multiple of CACHELINE */
+    void *free;
+    void *slabs;            /* linked through the first word of each slab */
+    unsigned int live, highwater, nslabs;
+} Pool;
+
+typedef struct {
+    bool dirty;             /* repaint on the next drawbar() regardless of state */
+    unsigned int version;   /* incremented on every repaint */
+    int x, w;               /* where the segment was last painted */
+} Segment;
 
 typedef struct {
     int x, y, w, h;
@@ -67,7 +125,8 @@ typedef struct {
     unsigned long sel[ColLast];
     HDC hdc;
     HPEN pen;
-    HBRUSH brush[2]; // 0=norm, 1=sel
+    HBRUSH brush[2]; // background, 0=norm, 1=sel
+    HBRUSH fgbrush[2]; // foreground, 0=norm, 1=sel
 } DC;
 
 DC dc;
@@ -87,6 +146,85 @@ typedef struct {
     const Arg arg;
 } Button;
 
+typedef struct Process Process;
+struct Process {
+    DWORD pid;
+    ULONGLONG created;          /* creation time, tells process instances apart */
+    const wchar_t *image;       /* interned full path of the executable */
+    unsigned int refs;          /* managed clients owned by the process */
+    Process *next;
+};
+
+/* Metadata of a new window that may take a round trip to another process,
+ * gathered by a worker thread. The UI thread fills in hwnd, pid and
+ * imagecap, the worker the rest. */
+typedef struct Query Query;
+struct Query {
+    HWND hwnd;
+    DWORD pid;
+    ULONGLONG created;
+    DWORD imagelen;             /* 0 if the process could not be queried */
+    LONG style, exstyle;
+    bool hasframe;
+    RECT insets;
+    Query *next;
+    DWORD imagecap;             /* room in image, 0 if the process is known */
+    wchar_t image[];
+};
+
+typedef struct {
+    HWND hwnd;
+    unsigned int what;      /* Ev* received since the last batch */
+} Event;
+
+/* The -r log is a RecHeader followed by one Record per event, each followed
+ * by a RecWindow if it has a snapshot. Written as laid out in memory. */
+typedef struct {
+    DWORD magic, version;
+    LONGLONG freq;          /* QueryPerformanceFrequency(), ticks of Record.t */
+} RecHeader;
+
+typedef struct {
+    LONGLONG t;             /* QueryPerformanceCounter() on arrival */
+    ULONGLONG hwnd;
+    DWORD kind;             /* Rec* */
+    DWORD code;             /* shell code, WinEvent, hotkey index or message */
+    DWORD snapshot;         /* a RecWindow follows */
+    DWORD pad;
+} Record;
+
+typedef struct {
+    DWORD pid;
+    DWORD style, exstyle;
+    RECT rect;
+    wchar_t classname[64];
+    wchar_t title[64];
+} RecWindow;
+
+/* Latency of one handler in QPC ticks. Values below HISTSUB have a bucket
+ * each, above that every power of two is split into HISTSUB buckets, so a
+ * bucket is never off by more than 1/HISTSUB of what it holds. */
+typedef struct {
+    unsigned int count;
+    ULONGLONG total, max;
+    unsigned int bucket[HISTBUCKETS];
+} Hist;
+
+/* A finished span, kept until the ring wraps or the trace is written.
+ * Class and monitor index are only looked up by writetrace(). */
+typedef struct {
+    LONGLONG start, end;    /* QueryPerformanceCounter() */
+    const wchar_t *name;    /* a literal or a layout symbol */
+    HWND hwnd;
+    Monitor *mon;
+} Span;
+
+/* A request read from the command pipe, handed to the UI thread. */
+typedef struct {
+    char *in;               /* commands, one per line, NUL terminated */
+    char out[256];          /* reply */
+} Command;
+
 typedef struct Client Client;
 struct Client {
     HWND hwnd;
@@ -94,22 +232,32 @@ struct Client {
     HWND root;
     DWORD threadid;
     DWORD processid;
+    Process *proc;
     const wchar_t *processname;
+    wchar_t classname[256];     /* never changes for the lifetime of a window */
+    wchar_t title[256];         /* refreshed on EVENT_OBJECT_NAMECHANGE */
     int x, y, w, h;
     int bw;
     unsigned int tags;
     bool isminimized;
     bool isfloating;
-    bool isalive;
-    bool ignore;
+    bool hidden;            /* hidden by showhide(), not by the application */
     bool ignoreborder;
     bool border;
     bool wasvisible;
     bool isfixed, isurgent;
-    bool iscloaked;
+    bool iscloaked;         /* kept current by EVENT_OBJECT_(UN)CLOAKED */
+    bool framevalid;        /* insets below are current for style/exstyle */
+    bool hasframe;          /* DWM reported extended frame bounds */
+    LONG style, exstyle;
+    RECT insets;            /* invisible resize borders around the frame */
+    bool querying;          /* a worker is gathering the fields above */
+    unsigned int placement; /* 1-based slot in the pending placement batch */
+    bool dirty;             /* visibility needs to be rechecked on the next flush */
+    unsigned int touched;   /* last flush that visited this client */
     Monitor *mon;
-    Client *next;
-    Client *snext;
+    Client *prev, *next;        /* tiling order, mon->clients is the head */
+    Client *sprev, *snext;      /* focus order, mon->stack is the head */
 };
 
 typedef struct {
@@ -119,10 +267,33 @@ typedef struct {
     const Arg arg;
 } Key;
 
-typedef struct {
+struct Layout {
     const wchar_t *symbol;
-    void (*arrange)(void);
-} Layout;
+    LayoutFunc arrange;     /* NULL means floating */
+};
+
+/* rules[] patterns are compiled into one Aho-Corasick automaton, built as a
+ * trie of first-child/next-sibling nodes with failure links. */
+typedef struct {
+    wchar_t ch;
+    int child, sibling;
+    int fail;       /* node of the longest proper suffix present in the trie */
+    int out;        /* nearest node on the fail chain that ends a pattern */
+    int match;      /* first RuleMatch ending at this node */
+} RuleNode;
+
+typedef struct {
+    unsigned int rule;
+    unsigned int field;
+    int next;
+} RuleMatch;
+
+typedef struct {
+    Client *c;
+    int x, y, w, h;     /* window rectangle, including the invisible borders */
+    int ox, oy, ow, oh; /* geometry before the batch, to drop no-op moves */
+    UINT flags;         /* SWP_SHOWWINDOW or SWP_HIDEWINDOW, if any */
+} Placement;
 
 typedef struct {
     const wchar_t *class;
@@ -130,8 +301,52 @@ typedef struct {
     unsigned int tags;
     bool isfloating;
     bool ignoreborder;
+    const wchar_t *process;     /* substring of the executable path, last so older
+                                 * config.h files still line up */
 } Rule;
 
+/* Everything the core asks of the window system about the desktop it
+ * manages: other windows, processes, monitors and the hooks that report on
+ * them. Our own bar and message windows, drawing and borders don't go
+ * through here. */
+typedef struct {
+    BOOL (*enumwindows)(WNDENUMPROC f, LPARAM lp);
+    HWND (*findwindow)(const wchar_t *class, const wchar_t *title);
+    HWND (*desktop)(void);
+    BOOL (*enummonitors)(MONITORENUMPROC f, LPARAM lp);
+    BOOL (*monitorinfo)(HMONITOR hmon, MONITORINFOEXW *mi);
+    HMONITOR (*windowmonitor)(HWND hwnd);
+    HMONITOR (*pointmonitor)(POINT pt);
+    BOOL (*cursorpos)(POINT *pt);
+    int (*metric)(int index);
+    BOOL (*windowinfo)(HWND hwnd, WINDOWINFO *wi);
+    DWORD (*windowthread)(HWND hwnd, DWORD *pid);
+    BOOL (*iswindow)(HWND hwnd);
+    HWND (*parent)(HWND hwnd);
+    HWND (*owner)(HWND hwnd);
+    LONG (*style)(HWND hwnd, int index);
+    BOOL (*visible)(HWND hwnd);
+    bool (*cloaked)(HWND hwnd);
+    bool (*frameinsets)(HWND hwnd, RECT *insets);
+    HRESULT (*setattribute)(HWND hwnd, DWORD attr, const void *val, DWORD size);
+    int (*classname)(HWND hwnd, wchar_t *buf, int len);
+    int (*title)(HWND hwnd, wchar_t *buf, int len);
+    /* image path and creation time, called on the worker threads */
+    bool (*processimage)(DWORD pid, wchar_t *buf, DWORD *len, ULONGLONG *created);
+    BOOL (*setwindowpos)(HWND hwnd, HWND after, int x, int y, int w, int h, UINT flags);
+    HDWP (*begindefer)(int n);
+    HDWP (*defer)(HDWP hdwp, HWND hwnd, HWND after, int x, int y, int w, int h, UINT flags);
+    BOOL (*enddefer)(HDWP hdwp);
+    BOOL (*setplacement)(HWND hwnd, const WINDOWPLACEMENT *wp);
+    BOOL (*foreground)(HWND hwnd);
+    BOOL (*close)(HWND hwnd);
+    BOOL (*shellhook)(HWND hwnd, bool on);
+    HWINEVENTHOOK (*hookevents)(DWORD min, DWORD max, WINEVENTPROC f);
+    BOOL (*unhookevents)(HWINEVENTHOOK hook);
+    BOOL (*registerhotkey)(HWND hwnd, int id, UINT mod, UINT key);
+    BOOL (*unregisterhotkey)(HWND hwnd, int id);
+} Platform;
+
 struct Monitor {
     HMONITOR hmon;
     MONITORINFOEXW mi;
@@ -139,6 +354,19 @@ struct Monitor {
     int by, bh, blw;
     int wx, wy, ww, wh; /* window area */
     HWND barhwnd;
+    Client *clients;    /* clients on this monitor, in tiling order */
+    Client *stack;      /* the same clients, in focus order */
+    HDC bardc;          /* off-screen buffer the bar is rendered into */
+    HBITMAP barbmp;
+    HGDIOBJ baroldbmp;
+    int barbw, barbh;   /* size of the buffer */
+    Segment seg[SegLast];
+    unsigned int bartags[4];        /* tagset, occupied, urgent, selected as last painted */
+    Layout *barlayout;
+    unsigned int barstatus;         /* stextversion last painted */
+    wchar_t bartitle[256];
+    unsigned int barflags;
+    unsigned int dirty;     /* Dirty* work pending for the next flush */
     Monitor *next;
 
     float mfact;
@@ -150,15 +378,26 @@ struct Monitor {
 
 /* function declarations */
 static void applyrules(Client *c);
+static bool applyprocessrules(Client *c);
+static void compilerules(void);
 static void arrange(void);
 static void arrangemon(Monitor *m);
 static void attach(Client *c);
 static void attachstack(Client *c);
+static void beginplacement(void);
 static void cleanup(void);
 static void clearurgent(Client *c);
+static void commitplacement(void);
+static Placement *placement(Client *c);
+static void placewindow(Client *c, int x, int y, int w, int h);
 static void detach(Client *c);
 static void detachstack(Client *c);
+static void swap(Client *a, Client *b);
+static void dirtybar(Monitor *m, unsigned int s);
+static void dirtyclient(Client *c);
+static void dirtymon(Monitor *m, unsigned int flags);
 static void drawbar(Monitor *m);
+static bool drawbuffer(Monitor *m);
 static void drawsquare(bool filled, bool empty, bool invert, unsigned long col[ColLast]);
 static void drawtext(const wchar_t *text, unsigned long col[ColLast], bool invert);
 static void drawborder(Client *c, COLORREF color);
@@ -166,16 +405,37 @@ static void nocorners(Client* c);
 void eprint(bool premortem, const wchar_t *errstr, ...);
 static void focus(Client *c);
 static void focusstack(const Arg *arg);
+static void flush(void);
+static void queueevent(HWND hwnd, unsigned int what);
+static void processevents(void);
+static void record(DWORD kind, DWORD code, HWND hwnd, bool snapshot);
+static void startrecording(const wchar_t *path);
+static void showprofile(const Arg *arg);
+static void dumpprofile(const Arg *arg);
+static LONGLONG profnow(void);
+static void traceend(LONGLONG start, const wchar_t *name, HWND hwnd, Monitor *m);
+static void toggletrace(const Arg *arg);
+static void writetrace(const wchar_t *path);
+static bool checkmanageable(HWND hwnd);
+static void jsonstr(FILE *f, const wchar_t *s);
+#ifdef PROFILE
+static unsigned int histbucket(ULONGLONG v);
+static ULONGLONG histbound(unsigned int b);
+static void histadd(Hist *h, LONGLONG ticks);
+static ULONGLONG histpercentile(const Hist *h, double p);
+static Hist *profhist(UINT msg, WPARAM wParam);
+static int profline(wchar_t *buf, size_t len, const wchar_t *name, unsigned int key, const Hist *h, double us);
+static void profreport(wchar_t *buf, size_t len);
+#endif
 static void movestack(const Arg *arg);
 static Client *getclient(HWND hwnd);
 LPWSTR getclientclassname(HWND hwnd);
 LPWSTR getclienttitle(HWND hwnd);
+static void updatetitle(Client *c);
 HWND getroot(HWND hwnd);
 static void grabkeys(HWND hwnd);
 static void killclient(const Arg *arg);
 static Client *manage(HWND hwnd);
-static void monocle(void);
-static Client *nextchild(Client *p, Client *c);
 static Client *nexttiled(Client *c);
 static void quit(const Arg *arg);
 static void resize(Client *c, int x, int y, int w, int h);
@@ -188,10 +448,11 @@ static void setup(HINSTANCE hInstance);
 static void setbar(HINSTANCE hInstance, Monitor *m);
 static void showclientinfo(const Arg *arg); 
 static void showhide(Client *c);
+static void updatevisibility(Client *c);
 static void spawn(const Arg *arg);
 static void tag(const Arg *arg);
+static void teardown(void);
 static int textnw(const wchar_t *text, unsigned int len);
-static void tile(void);
 static void togglebar(const Arg *arg);
 static void toggleexplorer(const Arg *arg);
 static void togglefloating(const Arg *arg);
@@ -207,39 +468,184 @@ static Monitor *monitor_from_hwnd(HWND hwnd);
 static Monitor *monitor_from_point(POINT pt);
 static void view(const Arg *arg);
 static void zoom(const Arg *arg);
-static bool iscloaked(HWND hwnd);
+static bool clientinsets(Client *c, RECT *insets);
+static void invalidateframes(void);
+static void checkframe(Client *c);
 static void focusmon(const Arg *arg);
+static void freebuffer(Monitor *m);
+static void *poolalloc(Pool *p);
+static void poolfree(Pool *p, void *obj);
+static void poolrelease(Pool *p);
+static Process *findprocess(DWORD pid, ULONGLONG created);
+static Process *liveprocess(DWORD pid);
+static Process *addprocess(DWORD pid, ULONGLONG created, const wchar_t *image, size_t len);
+static void queuequery(Client *c);
+static void completequeries(void);
+static void startworkers(void);
+static void stopworkers(void);
+static void startcmdserver(void);
+static void stopcmdserver(void);
+static void runcommands(Command *cmd);
+static void startstatusfeed(void);
+static void stopstatusfeed(void);
+static void publishstatus(const char *line);
+static void takestatus(void);
+static void setstatus(const wchar_t *markup);
+static void drawstatus(void);
+static char *cmdtoken(char **s);
+static Client *cmdtarget(const char *t);
+static void releaseprocess(Process *p);
 static void sendmon(const Arg *arg);
 
 typedef BOOL (*RegisterShellHookWindowProc) (HWND);
 
 static HWND dwmhwnd;
-static HWINEVENTHOOK wineventhook;
+/* WinEvent ranges we listen to, hooked out of context */
+static const DWORD winevents[][2] = {
+    { EVENT_SYSTEM_MINIMIZESTART, EVENT_SYSTEM_MINIMIZEEND },
+    { EVENT_OBJECT_CREATE, EVENT_OBJECT_HIDE },
+    { EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_NAMECHANGE },
+    { EVENT_OBJECT_CLOAKED, EVENT_OBJECT_UNCLOAKED },
+};
+static HWINEVENTHOOK wineventhooks[LENGTH(winevents)];
 static HFONT font;
 
 static wchar_t stext[256];
+static unsigned char stextcol[LENGTH(stext)];  /* Status* of each character */
+static unsigned int stextversion = 0;
+static int stextw = 0;
+static unsigned int stextmeasured = 0;         /* stextversion stextw is the width of */
+static unsigned long barrepaints[SegLast];
 
 static Monitor *curmon = NULL;
 
 /* Legacy global fallbacks */
-static unsigned int seltags = 0, sellt = 0;
+static unsigned int seltags = 0;
 static Layout* lt[] = { NULL, NULL };
 
-static Client *clients = NULL;
 static Client *sel = NULL;
-static Client *stack = NULL;
+static unsigned int selections = 0;    /* setselected() calls, so runcommands() sees focus moves */
+static Pool clientpool = { (sizeof(Client) + CACHELINE - 1) / CACHELINE * CACHELINE };
+static Pool monitorpool = { (sizeof(Monitor) + CACHELINE - 1) / CACHELINE * CACHELINE };
+static Client **chash = NULL;
+static unsigned int chashcap = 0, chashlen = 0;
+
+/* processes of managed clients, hashed by PID, and the string arena their
+ * image paths are interned in */
+static Process *procs[64];
+static Process *freeprocs = NULL;
+static const wchar_t **images = NULL;
+static unsigned int imagescap = 0, nimages = 0;
+static struct {
+    wchar_t *buf;
+    size_t used, size;
+} arena;
+static size_t arenabytes = 0, arenaused = 0;
+static void **arenablocks = NULL;
+static unsigned int narenablocks = 0;
+static unsigned int nprocs = 0;
+
+/* queries waiting for a worker, and answered ones waiting for the UI thread */
+static struct {
+    SRWLOCK lock;
+    CONDITION_VARIABLE cv;
+    Query *jobs, **jobstail;
+    Query *done;
+    HANDLE event;           /* set when done becomes non-empty */
+    HANDLE threads[NWORKERS];
+    bool quit;
+} queries;
+
+/* lines read by the status feed thread, taken by the UI thread at most
+ * once per display refresh */
+static struct {
+    SRWLOCK lock;
+    wchar_t text[LENGTH(stext)];   /* newest line */
+    bool posted;            /* a WM_STATUSFEED is on its way */
+    HANDLE thread;
+    HANDLE pipe;            /* if statusfeed names a pipe */
+    HANDLE stop;            /* set with quit, ends the wait between polls */
+    volatile LONG quit;
+    ULONGLONG shown;        /* GetTickCount64() of the last update taken */
+    DWORD period;           /* ms per display refresh */
+} feed;
+
+/* the command pipe, one request at a time on a thread of its own */
+static struct {
+    HANDLE thread;
+    HANDLE pipe;
+    volatile LONG quit;
+} cmdserver;
+
+static Placement *placements = NULL;
+static unsigned int nplacements = 0, placementscap = 0;
+static unsigned int deferdepth = 0;
+static struct {
+    unsigned int queued;    /* resize() requests collected */
+    unsigned int dropped;   /* requests that ended where they started */
+    unsigned int deferred;  /* windows moved through DeferWindowPos */
+    unsigned int swpcalls;  /* SetWindowPos calls issued */
+    unsigned int monitors;  /* monitors laid out or repainted */
+    unsigned int clients;   /* distinct clients visited */
+} arrstats;
+
+/* clients whose visibility changed outside of a monitor wide change */
+static Client **dirtyclients = NULL;
+static unsigned int ndirtyclients = 0, dirtyclientscap = 0;
+static unsigned int flushes = 0;
+static unsigned int arranges = 0;   /* flushes that laid out a monitor */
+static Rect *rects = NULL;          /* arrangemon() output, one per tiled client */
+static unsigned int rectscap = 0;
+static unsigned int holdflush = 0;  /* flush() leaves the work to an outer caller */
+
+/* shell hook and WinEvent notifications, one entry per window, handled in
+ * one batch when the message queue runs dry or after eventdelay ms */
+static struct {
+    Event *ev;
+    unsigned int n, cap;
+    HWND activated;         /* only the last activation of a burst matters */
+    unsigned int received, batches;
+} events;
 
 static UINT shellhookid;
+static FILE *recfile = NULL;   /* -r log, if recording */
+static bool tracing = false;    /* spans are being recorded */
+static Span *spans = NULL;
+static unsigned int nspans = 0; /* spans recorded, the ring holds the last TRACESPANS */
 
 static Monitor *mons = NULL;
 static Monitor *selmon = NULL;
 
 /* configuration, allows nested code to access above variables */
-#include "config.h"
+#ifndef CONFIG
+#define CONFIG "config.h"
+#endif
+#include CONFIG
 
 /* compile-time check if all tags fit into an unsigned int bit array. */
 struct NumTags { wchar_t limitexceeded[sizeof(unsigned int) * 8 < LENGTH(tags) ? -1 : 1]; };
 static int tagw[LENGTH(tags)];
+#ifdef PROFILE
+/* only ever touched on the UI thread, so plain counters do */
+static Hist prof[ProfLast];
+static Hist keyprof[LENGTH(keys)];
+static const wchar_t *profnames[ProfLast] = {
+    [ProfClose] = L"WM_CLOSE", [ProfEventTimer] = L"WM_TIMER",
+    [ProfDisplay] = L"WM_DISPLAYCHANGE", [ProfShell] = L"shell hook",
+    [ProfWinEvent] = L"wineventproc", [ProfBarPaint] = L"bar WM_PAINT",
+    [ProfBar] = L"bar other", [ProfEvents] = L"processevents",
+    [ProfQueries] = L"completequeries", [ProfCommand] = L"pipe command",
+    [ProfStatus] = L"status feed", [ProfOther] = L"other messages",
+};
+#endif
+
+static RuleNode *rulenodes = NULL;
+static unsigned int nrulenodes = 0, rulenodescap = 0;
+static RuleMatch *rulematches = NULL;
+static unsigned int nrulematches = 0;
+static int rulestart[128];      /* root transitions for ASCII, the common case */
+static unsigned char ruleneed[LENGTH(rules)];   /* fields a rule has patterns for */
+static unsigned char rulehits[LENGTH(rules)];   /* fields matched for the current client */
 
 /* elements of the window whose color should be set to the values in the array below */
 static int colorwinelements[] = { COLOR_ACTIVEBORDER, COLOR_INACTIVEBORDER };
@@ -247,6 +653,7 @@ static COLORREF colors[2][LENGTH(colorwinelements)] = {
     { 0, 0 }, /* used to save the values before dwm started */
     { selbordercolor, normbordercolor },
 };
+static bool colorssaved = false;
 
 static inline bool
 isvisible(Client *x) {
@@ -268,6 +675,161 @@ mon_get_layout(Monitor *m, unsigned int idx) {
     return lt[0];
 }
 
+void *
+poolalloc(Pool *p) {
+    char *slab, *slot;
+    size_t i;
+
+    if (!p->free) {
+        if (!(slab = VirtualAlloc(NULL, SLABSIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE)))
+            return NULL;
+        /* the first slot links the slabs, the others are handed out */
+        *(void **)slab = p->slabs;
+        p->slabs = slab;
+        p->nslabs++;
+        for (i = SLABSIZE / p->size - 1; i > 0; i--) {
+            slot = slab + i * p->size;
+#ifdef POOLDEBUG
+            memset(slot, POISON, p->size);
+#endif
+            *(void **)slot = p->free;
+            p->free = slot;
+        }
+    }
+
+    slot = p->free;
+    p->free = *(void **)slot;
+#ifdef POOLDEBUG
+    /* anything but the link overwritten means a write after poolfree() */
+    for (i = sizeof(void *); i < p->size; i++) {
+        if ((unsigned char)slot[i] != POISON) {
+            debug(L"poolalloc: slot %p was modified after it was freed\n", slot);
+            break;
+        }
+    }
+#endif
+    memset(slot, 0, p->size);
+    if (++p->live > p->highwater)
+        p->highwater = p->live;
+    return slot;
+}
+
+void
+poolfree(Pool *p, void *obj) {
+    if (!obj)
+        return;
+#ifdef POOLDEBUG
+    memset(obj, POISON, p->size);
+#endif
+    *(void **)obj = p->free;
+    p->free = obj;
+    p->live--;
+}
+
+/* Returns every slab to the system, all records of the pool become invalid. */
+void
+poolrelease(Pool *p) {
+    void *slab;
+
+    while ((slab = p->slabs)) {
+        p->slabs = *(void **)slab;
+        VirtualFree(slab, 0, MEM_RELEASE);
+    }
+    p->free = NULL;
+    p->live = p->nslabs = 0;
+}
+
+/* The user32/dwmapi backend, thin wrappers so the table doesn't depend on
+ * how the SDK headers declare each call. */
+static BOOL
+w32enumwindows(WNDENUMPROC f, LPARAM lp) {
+    return EnumWindows(f, lp);
+}
+
+static HWND
+w32findwindow(const wchar_t *class, const wchar_t *title) {
+    return FindWindowW(class, title);
+}
+
+static HWND
+w32desktop(void) {
+    return GetDesktopWindow();
+}
+
+static BOOL
+w32enummonitors(MONITORENUMPROC f, LPARAM lp) {
+    return EnumDisplayMonitors(NULL, NULL, f, lp);
+}
+
+static BOOL
+w32monitorinfo(HMONITOR hmon, MONITORINFOEXW *mi) {
+    return GetMonitorInfoW(hmon, (MONITORINFO *)mi);
+}
+
+static HMONITOR
+w32windowmonitor(HWND hwnd) {
+    return MonitorFromWindow(hwnd, MONITOR_DEFAULTTONEAREST);
+}
+
+static HMONITOR
+w32pointmonitor(POINT pt) {
+    return MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST);
+}
+
+static BOOL
+w32cursorpos(POINT *pt) {
+    return GetCursorPos(pt);
+}
+
+static int
+w32metric(int index) {
+    return GetSystemMetrics(index);
+}
+
+static BOOL
+w32windowinfo(HWND hwnd, WINDOWINFO *wi) {
+    return GetWindowInfo(hwnd, wi);
+}
+
+static DWORD
+w32windowthread(HWND hwnd, DWORD *pid) {
+    return GetWindowThreadProcessId(hwnd, pid);
+}
+
+static BOOL
+w32iswindow(HWND hwnd) {
+    return IsWindow(hwnd);
+}
+
+static HWND
+w32parent(HWND hwnd) {
+    return GetParent(hwnd);
+}
+
+static HWND
+w32owner(HWND hwnd) {
+    return GetWindow(hwnd, GW_OWNER);
+}
+
+static LONG
+w32style(HWND hwnd, int index) {
+    return GetWindowLong(hwnd, index);
+}
+
+static BOOL
+w32visible(HWND hwnd) {
+    return IsWindowVisible(hwnd);
+}
+
+static bool
+iscloaked(HWND hwnd) {
+    int cloaked_val;
+    HRESULT h_res = DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &cloaked_val, sizeof(cloaked_val));
+    if (h_res != S_OK)
+        cloaked_val = 0;
+    return cloaked_val ? true : false;
+}
+
 static bool
 getframebounds(HWND hwnd, RECT *insets) {
     if (!insets || !IsWindow(hwnd)) return false;
@@ -287,16 +849,304 @@ getframebounds(HWND hwnd, RECT *insets) {
     return true;
 }
 
+static HRESULT
+w32setattribute(HWND hwnd, DWORD attr, const void *val, DWORD size) {
+    return DwmSetWindowAttribute(hwnd, attr, val, size);
+}
+
+static int
+w32classname(HWND hwnd, wchar_t *buf, int len) {
+    return GetClassNameW(hwnd, buf, len);
+}
+
+/* InternalGetWindowText() reads the title stored by the window manager
+ * instead of sending WM_GETTEXT, so a hung application can't block us. */
+static int
+w32title(HWND hwnd, wchar_t *buf, int len) {
+    return InternalGetWindowText(hwnd, buf, len);
+}
+
+static bool
+w32processimage(DWORD pid, wchar_t *buf, DWORD *len, ULONGLONG *created) {
+    HANDLE hproc;
+    FILETIME ct, exited, kernel, user;
+    bool ok;
+
+    if (!(hproc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid)))
+        return false;
+    ok = QueryFullProcessImageNameW(hproc, 0, buf, len)
+        && GetProcessTimes(hproc, &ct, &exited, &kernel, &user);
+    if (ok)
+        *created = (ULONGLONG)ct.dwHighDateTime << 32 | ct.dwLowDateTime;
+    CloseHandle(hproc);
+    return ok;
+}
+
+static BOOL
+w32setwindowpos(HWND hwnd, HWND after, int x, int y, int w, int h, UINT flags) {
+    return SetWindowPos(hwnd, after, x, y, w, h, flags);
+}
+
+static HDWP
+w32begindefer(int n) {
+    return BeginDeferWindowPos(n);
+}
+
+static HDWP
+w32defer(HDWP hdwp, HWND hwnd, HWND after, int x, int y, int w, int h, UINT flags) {
+    return DeferWindowPos(hdwp, hwnd, after, x, y, w, h, flags);
+}
+
+static BOOL
+w32enddefer(HDWP hdwp) {
+    return EndDeferWindowPos(hdwp);
+}
+
+static BOOL
+w32setplacement(HWND hwnd, const WINDOWPLACEMENT *wp) {
+    return SetWindowPlacement(hwnd, wp);
+}
+
+static BOOL
+w32foreground(HWND hwnd) {
+    return SetForegroundWindow(hwnd);
+}
+
+static BOOL
+w32close(HWND hwnd) {
+    return PostMessage(hwnd, WM_CLOSE, 0, 0);
+}
+
+static BOOL
+w32shellhook(HWND hwnd, bool on) {
+    return on ? RegisterShellHookWindow(hwnd) : DeregisterShellHookWindow(hwnd);
+}
+
+static HWINEVENTHOOK
+w32hookevents(DWORD min, DWORD max, WINEVENTPROC f) {
+    return SetWinEventHook(min, max, NULL, f, 0, 0, WINEVENT_OUTOFCONTEXT);
+}
+
+static BOOL
+w32unhookevents(HWINEVENTHOOK hook) {
+    return UnhookWinEvent(hook);
+}
+
+static BOOL
+w32registerhotkey(HWND hwnd, int id, UINT mod, UINT key) {
+    return RegisterHotKey(hwnd, id, mod, key);
+}
+
+static BOOL
+w32unregisterhotkey(HWND hwnd, int id) {
+    return UnregisterHotKey(hwnd, id);
+}
+
+static const Platform win32 = {
+    .enumwindows = w32enumwindows,
+    .findwindow = w32findwindow,
+    .desktop = w32desktop,
+    .enummonitors = w32enummonitors,
+    .monitorinfo = w32monitorinfo,
+    .windowmonitor = w32windowmonitor,
+    .pointmonitor = w32pointmonitor,
+    .cursorpos = w32cursorpos,
+    .metric = w32metric,
+    .windowinfo = w32windowinfo,
+    .windowthread = w32windowthread,
+    .iswindow = w32iswindow,
+    .parent = w32parent,
+    .owner = w32owner,
+    .style = w32style,
+    .visible = w32visible,
+    .cloaked = iscloaked,
+    .frameinsets = getframebounds,
+    .setattribute = w32setattribute,
+    .classname = w32classname,
+    .title = w32title,
+    .processimage = w32processimage,
+    .setwindowpos = w32setwindowpos,
+    .begindefer = w32begindefer,
+    .defer = w32defer,
+    .enddefer = w32enddefer,
+    .setplacement = w32setplacement,
+    .foreground = w32foreground,
+    .close = w32close,
+    .shellhook = w32shellhook,
+    .hookevents = w32hookevents,
+    .unhookevents = w32unhookevents,
+    .registerhotkey = w32registerhotkey,
+    .unregisterhotkey = w32unregisterhotkey,
+};
+
+static const Platform *pf = &win32;
+
+/* Frame insets only change with the window style, which checkframe()
+ * watches, or with the DPI, which invalidateframes() handles. */
+bool
+clientinsets(Client *c, RECT *insets) {
+    if (!c->framevalid) {
+        if (c->querying)
+            return false;   /* don't wait for DWM, a worker is asking already */
+        c->style = pf->style(c->hwnd, GWL_STYLE);
+        c->exstyle = pf->style(c->hwnd, GWL_EXSTYLE);
+        c->hasframe = pf->frameinsets(c->hwnd, &c->insets);
+        c->framevalid = true;
+    }
+    *insets = c->insets;
+    return c->hasframe;
+}
+
+/* Windows has no event for style changes, but a window changing its frame
+ * moves or resizes, so the style is compared once per batch of moves. The
+ * style is read from the shared desktop heap. */
+void
+checkframe(Client *c) {
+    if (c->framevalid && (pf->style(c->hwnd, GWL_STYLE) != c->style
+    || pf->style(c->hwnd, GWL_EXSTYLE) != c->exstyle))
+        c->framevalid = false;
+}
+
+/* Turns the visible frame x, y, w, h of c into the window rectangle, which
+ * also holds the invisible resize borders. */
+static void
+outerrect(Client *c, int *x, int *y, int *w, int *h) {
+    RECT in;
+
+    if (!clientinsets(c, &in))
+        return;
+    *x -= in.left;
+    *y -= in.top;
+    *w += in.left + in.right;
+    *h += in.top + in.bottom;
+}
+
+void
+invalidateframes(void) {
+    for (Monitor *m = mons; m; m = m->next)
+        for (Client *c = m->clients; c; c = c->next)
+            c->framevalid = false;
+}
+
+static int
+rulechild(int n, wchar_t ch) {
+    if (n == 0 && ch < LENGTH(rulestart))
+        return rulestart[ch];
+    for (n = rulenodes[n].child; n > 0; n = rulenodes[n].sibling)
+        if (rulenodes[n].ch == ch)
+            return n;
+    return -1;
+}
+
+static int
+rulenode(int parent, wchar_t ch) {
+    RuleNode *n;
+
+    if (nrulenodes == rulenodescap) {
+        rulenodescap = rulenodescap ? rulenodescap * 2 : 256;
+        if (!(n = realloc(rulenodes, rulenodescap * sizeof(RuleNode))))
+            die(L"fatal: could not realloc() %u bytes for rules\n", (unsigned)(rulenodescap * sizeof(RuleNode)));
+        rulenodes = n;
+    }
+    n = &rulenodes[nrulenodes];
+    n->ch = ch;
+    n->child = -1;
+    n->fail = 0;
+    n->out = -1;
+    n->match = -1;
+    if (parent >= 0) {
+        n->sibling = rulenodes[parent].child;
+        rulenodes[parent].child = nrulenodes;
+        if (parent == 0 && ch < LENGTH(rulestart))
+            rulestart[ch] = nrulenodes;
+    } else {
+        n->sibling = -1;
+    }
+    return nrulenodes++;
+}
+
+void
+compilerules(void) {
+    const wchar_t *pattern;
+    unsigned int i, f, head, tail;
+    int n, m, k, *queue;
+
+    for (i = 0; i < LENGTH(rulestart); i++)
+        rulestart[i] = -1;
+    nrulenodes = 0;
+    rulenode(-1, 0);
+
+    if (!(rulematches = calloc(LENGTH(rules) * RuleLast, sizeof(RuleMatch))))
+        die(L"fatal: could not calloc() %u bytes for rules\n", (unsigned)(LENGTH(rules) * RuleLast * sizeof(RuleMatch)));
+
+    for (i = 0; i < LENGTH(rules); i++) {
+        for (f = 0; f < RuleLast; f++) {
+            pattern = f == RuleClass ? rules[i].class : f == RuleTitle ? rules[i].title : rules[i].process;
+            /* like wcsstr(), an empty pattern matches anything */
+            if (!pattern || !pattern[0])
+                continue;
+            for (n = 0; *pattern; pattern++)
+                n = (m = rulechild(n, *pattern)) > 0 ? m : rulenode(n, *pattern);
+            rulematches[nrulematches].rule = i;
+            rulematches[nrulematches].field = f;
+            rulematches[nrulematches].next = rulenodes[n].match;
+            rulenodes[n].match = nrulematches++;
+            ruleneed[i] |= 1 << f;
+        }
+    }
+
+    /* breadth first, so failure links always point to finished nodes */
+    if (!(queue = calloc(nrulenodes, sizeof(int))))
+        die(L"fatal: could not calloc() %u bytes for rules\n", (unsigned)(nrulenodes * sizeof(int)));
+    head = tail = 0;
+    for (n = rulenodes[0].child; n > 0; n = rulenodes[n].sibling) {
+        rulenodes[n].out = rulenodes[n].match >= 0 ? n : -1;
+        queue[tail++] = n;
+    }
+    while (head < tail) {
+        m = queue[head++];
+        for (n = rulenodes[m].child; n > 0; n = rulenodes[n].sibling) {
+            for (k = rulenodes[m].fail; k && rulechild(k, rulenodes[n].ch) < 0; k = rulenodes[k].fail);
+            k = rulechild(k, rulenodes[n].ch);
+            rulenodes[n].fail = k > 0 ? k : 0;
+            rulenodes[n].out = rulenodes[n].match >= 0 ? n : rulenodes[rulenodes[n].fail].out;
+            queue[tail++] = n;
+        }
+    }
+    free(queue);
+}
+
+/* Scans text once and marks every rule that has a pattern for field f in it. */
+static void
+matchrules(const wchar_t *text, unsigned int f) {
+    int n = 0, m, o, k;
+
+    for (; text && *text; text++) {
+        while ((m = rulechild(n, *text)) < 0 && n)
+            n = rulenodes[n].fail;
+        n = m > 0 ? m : 0;
+        for (o = rulenodes[n].out; o > 0; o = rulenodes[rulenodes[o].fail].out)
+            for (k = rulenodes[o].match; k >= 0; k = rulematches[k].next)
+                if (rulematches[k].field == f)
+                    rulehits[rulematches[k].rule] |= 1 << f;
+    }
+}
+
 void
 applyrules(Client *c) {
     unsigned int i;
     Rule *r;
+    TRACESTART(t);
+
+    /* rule matching, every string is scanned once for all rules */
+    memset(rulehits, 0, sizeof(rulehits));
+    matchrules(c->classname, RuleClass);
+    matchrules(c->title, RuleTitle);
+    matchrules(c->processname, RuleProcess);
 
-    /* rule matching */
     for (i = 0; i < LENGTH(rules); i++) {
         r = &rules[i];
-        if ((!r->title || wcsstr(getclienttitle(c->hwnd), r->title))
-        && (!r->class || wcsstr(getclientclassname(c->hwnd), r->class))) {
+        if ((rulehits[i] & ruleneed[i]) == ruleneed[i]) {
             c->isfloating = r->isfloating;
             c->ignoreborder = r->ignoreborder;
             unsigned int default_ts = tagset[seltags];
@@ -311,38 +1161,198 @@ applyrules(Client *c) {
             default_ts = c->mon->tagset[c->mon->seltags];
         c->tags = default_ts;
     }
+    TRACEEND(t, L"applyrules", c->hwnd, c->mon);
+}
+
+/* Applies the rules with a process pattern once the process of c is known,
+ * manage() could only decide the others. The user may have retagged or
+ * floated c since, so nothing is touched unless one of them matches; a
+ * match with tags 0 moves c to the current view, as in applyrules(). */
+bool
+applyprocessrules(Client *c) {
+    unsigned int i, newtags = 0;
+    bool matched = false;
+
+    for (i = 0; i < LENGTH(rules) && !(ruleneed[i] & 1 << RuleProcess); i++);
+    if (i == LENGTH(rules))
+        return false;
+    memset(rulehits, 0, sizeof(rulehits));
+    matchrules(c->classname, RuleClass);
+    matchrules(c->title, RuleTitle);
+    matchrules(c->processname, RuleProcess);
+
+    for (; i < LENGTH(rules); i++) {
+        if (!(ruleneed[i] & 1 << RuleProcess) || (rulehits[i] & ruleneed[i]) != ruleneed[i])
+            continue;
+        c->isfloating = rules[i].isfloating;
+        c->ignoreborder = rules[i].ignoreborder;
+        if (rules[i].tags & TAGMASK)
+            newtags |= rules[i].tags & TAGMASK;
+        else
+            newtags |= c->mon ? c->mon->tagset[c->mon->seltags] : tagset[seltags];
+        matched = true;
+    }
+    if (newtags)
+        c->tags = newtags;
+    return matched;
 }
 
+/* Relayout, show/hide and repaint everything, for changes that affect all
+ * monitors such as a display change. Everything else marks what it touched
+ * with dirtymon()/dirtyclient() and calls flush(). */
 void
 arrange(void) {
-    showhide(stack);
-    focus(NULL);
-    for (Monitor *m = mons; m; m = m->next) {
-        arrangemon(m);
-    }
-    restack();
+    TRACESTART(t);
+
+    for (Monitor *m = mons; m; m = m->next)
+        m->dirty = DirtyAll;
+    flush();
+    TRACEEND(t, L"arrange", NULL, NULL);
 }
 
 void
 arrangemon(Monitor *m) {
+    LayoutFunc f = mon_get_layout(m, m->sellt)->arrange;
+    LayoutParams p = { { m->wx, m->wy, m->ww, m->wh }, 0, m->mfact, 0, gappx, m->bh };
+    unsigned int i;
+    Client *c;
+
     curmon = m;
+    if (!f)
+        return;
+    for (c = nexttiled(m->clients); c; c = nexttiled(c->next)) {
+        p.bw = c->bw;   /* all clients share one border width */
+        p.n++;
+    }
+    if (!p.n)
+        return;
+    TRACESTART(t);
+    if (p.n > rectscap) {
+        Rect *r = realloc(rects, p.n * sizeof(Rect));
+        if (!r)
+            die(L"fatal: could not realloc() %u bytes\n", p.n * (unsigned)sizeof(Rect));
+        rects = r;
+        rectscap = p.n;
+    }
+    TRACESTART(lf);
+    layoutrects(f, &p, rects);
+    TRACEEND(lf, mon_get_layout(m, m->sellt)->symbol, NULL, m);
+    for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+        resize(c, rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+    TRACEEND(t, L"arrangemon", NULL, m);
+}
+
+void
+dirtymon(Monitor *m, unsigned int flags) {
+    if (m)
+        m->dirty |= flags;
+}
+
+void
+dirtyclient(Client *c) {
+    if (!c || c->dirty)
+        return;
+    if (ndirtyclients == dirtyclientscap) {
+        unsigned int cap = dirtyclientscap ? dirtyclientscap * 2 : 16;
+        Client **t = realloc(dirtyclients, cap * sizeof(Client *));
+        if (!t)
+            die(L"fatal: could not realloc() %u bytes\n", cap * (unsigned)sizeof(Client *));
+        dirtyclients = t;
+        dirtyclientscap = cap;
+    }
+    dirtyclients[ndirtyclients++] = c;
+    c->dirty = true;
+}
+
+static void
+touchclient(Client *c) {
+    if (c->touched != flushes) {
+        c->touched = flushes;
+        arrstats.clients++;
+    }
+}
+
+/* Do the pending work: visibility of dirty clients and of every client on
+ * monitors whose view changed and the layout of dirty monitors, all in one
+ * placement batch, then focus and the bars. */
+void
+flush(void) {
+    bool shown = false, arranged = false;
+    unsigned int i;
+    Monitor *m;
+    Client *c;
+
+    if (holdflush)
+        return;
+    TRACESTART(t);
+    holdflush++;
+    memset(&arrstats, 0, sizeof(arrstats));
+    if (++flushes == 0)
+        flushes = 1;    /* 0 means never touched */
+
+    beginplacement();
+    for (m = mons; m; m = m->next) {
+        if (!(m->dirty & DirtyVisibility))
+            continue;
+        for (c = m->stack; c; c = c->snext)
+            touchclient(c);
+        showhide(m->stack);
+        shown = true;
+    }
+    for (i = 0; i < ndirtyclients; i++) {
+        c = dirtyclients[i];
+        c->dirty = false;
+        if (c->mon && (c->mon->dirty & DirtyVisibility))
+            continue;
+        touchclient(c);
+        updatevisibility(c);
+        shown = true;
+    }
+    ndirtyclients = 0;
 
-    if (mon_get_layout(m, m->sellt)->arrange)
-        mon_get_layout(m, m->sellt)->arrange();
+    for (m = mons; m; m = m->next) {
+        if (m->dirty & DirtyLayout) {
+            arrangemon(m);
+            arranged = true;
+        }
+    }
+    arranges += arranged;
+    commitplacement();
+    restack();
+    if (shown || (sel && !ISVISIBLE(sel)))
+        focus(NULL);
 
-    drawbar(m);
+    for (m = mons; m; m = m->next) {
+        if (!m->dirty)
+            continue;
+        if (m->dirty & (DirtyBar | DirtyLayout))
+            drawbar(m);
+        m->dirty = 0;
+        arrstats.monitors++;
+    }
+    holdflush--;
+    debug(L"flush: %u monitors, %u clients, %u queued, %u dropped, %u deferred, %u SetWindowPos\n",
+          arrstats.monitors, arrstats.clients, arrstats.queued, arrstats.dropped,
+          arrstats.deferred, arrstats.swpcalls);
+    TRACEEND(t, L"flush", NULL, NULL);
 }
 
 void
 attach(Client *c) {
-    c->next = clients;
-    clients = c;
+    c->prev = NULL;
+    c->next = c->mon->clients;
+    if (c->next)
+        c->next->prev = c;
+    c->mon->clients = c;
 }
 
 void
 attachstack(Client *c) {
-    c->snext = stack;
-    stack = c;
+    c->sprev = NULL;
+    c->snext = c->mon->stack;
+    if (c->snext)
+        c->snext->sprev = c;
+    c->mon->stack = c;
 }
 
 static Monitor *
@@ -358,8 +1368,10 @@ buttonpress(unsigned int button, POINTS *point, Monitor *m) {
     unsigned int i, x, click;
     Arg arg = {0};
 
-    /* XXX: hack */
-    dc.hdc = GetWindowDC(m->barhwnd);
+    /* TEXTW() measures with the font selected into the bar buffer */
+    if (!drawbuffer(m))
+        return;
+    dc.hdc = m->bardc;
 
     i = x = 0;
 
@@ -390,41 +1402,93 @@ buttonpress(unsigned int button, POINTS *point, Monitor *m) {
 
 void
 cleanup(void) {
+    static bool done = false;
     int i;
 
+    /* WM_CLOSE and the end of wWinMain() both get here, the pools are gone after the first */
+    if (done)
+        return;
+    done = true;
+
     /* kill timers on bars */
     for (Monitor *m = mons; m; m = m->next) {
         if (m->barhwnd) KillTimer(m->barhwnd, 1);
     }
 
     for (i = 0; i < LENGTH(keys); i++) {
-        UnregisterHotKey(dwmhwnd, i);
+        pf->unregisterhotkey(dwmhwnd, i);
     }
 
-    DeregisterShellHookWindow(dwmhwnd);
-
-    if (wineventhook != NULL)
-        UnhookWinEvent(wineventhook);
+    pf->shellhook(dwmhwnd, false);
+    stopcmdserver();
+    stopstatusfeed();
+    stopworkers();
 
-    /* show everything before exit */
-    Arg a = {.ui = ~0};
-    Layout foo = { L"", NULL };
-    view(&a);
-    lt[sellt] = &foo;
-    while (stack)
-        unmanage(stack);
+    for (i = 0; i < LENGTH(wineventhooks); i++) {
+        if (wineventhooks[i])
+            pf->unhookevents(wineventhooks[i]);
+        wineventhooks[i] = NULL;
+    }
 
-    SetSysColors(LENGTH(colorwinelements), colorwinelements, colors[0]); 
+    teardown();
+    if (recfile) {
+        fclose(recfile);
+        recfile = NULL;
+    }
+    free(chash);
+    chash = NULL;
+    chashcap = chashlen = 0;
+    free(placements);
+    placements = NULL;
+    nplacements = placementscap = 0;
+    free(dirtyclients);
+    dirtyclients = NULL;
+    ndirtyclients = dirtyclientscap = 0;
+    free(rects);
+    rects = NULL;
+    rectscap = 0;
+    tracing = false;
+    free(spans);
+    spans = NULL;
+    free(events.ev);
+    memset(&events, 0, sizeof(events));
+    while (freeprocs) {
+        Process *p = freeprocs;
+        freeprocs = p->next;
+        free(p);
+    }
+    for (i = 0; i < narenablocks; i++)
+        free(arenablocks[i]);
+    free(arenablocks);
+    free(images);
+    arenablocks = NULL;
+    images = NULL;
+    narenablocks = imagescap = nimages = 0;
+    memset(&arena, 0, sizeof(arena));
+    arenabytes = arenaused = 0;
+    free(rulenodes);
+    free(rulematches);
+    rulenodes = NULL;
+    rulematches = NULL;
+    nrulenodes = rulenodescap = nrulematches = 0;
+
+    /* die() before setup() must not paint the borders with unsaved colors */
+    if (colorssaved)
+        SetSysColors(LENGTH(colorwinelements), colorwinelements, colors[0]); 
 
     /* destroy bars */
     for (Monitor *m = mons; m; m = m->next) {
+        freebuffer(m);
         if (m->barhwnd) DestroyWindow(m->barhwnd);
     }
+    mons = selmon = curmon = NULL;
+    poolrelease(&monitorpool);
+    poolrelease(&clientpool);
 
     DestroyWindow(dwmhwnd);
 
     HWND hwnd;
-    hwnd = FindWindowW(L"Shell_TrayWnd", NULL);
+    hwnd = pf->findwindow(L"Shell_TrayWnd", NULL);
     if (hwnd)
         setvisibility(hwnd, TRUE);
 
@@ -434,6 +1498,8 @@ cleanup(void) {
     if (dc.pen) DeleteObject(dc.pen);
     if (dc.brush[0]) DeleteObject(dc.brush[0]);
     if (dc.brush[1]) DeleteObject(dc.brush[1]);
+    if (dc.fgbrush[0]) DeleteObject(dc.fgbrush[0]);
+    if (dc.fgbrush[1]) DeleteObject(dc.fgbrush[1]);
 }
 
 void
@@ -443,132 +1509,307 @@ clearurgent(Client *c) {
 
 void
 detach(Client *c) {
-    Client **tc;
-
-    for (tc = &clients; *tc && *tc != c; tc = &(*tc)->next);
-    *tc = c->next;
+    if (c->prev)
+        c->prev->next = c->next;
+    else if (c->mon->clients == c)
+        c->mon->clients = c->next;
+    if (c->next)
+        c->next->prev = c->prev;
+    c->prev = c->next = NULL;
 }
 
 void
 detachstack(Client *c) {
-    Client **tc;
-
-    for (tc = &stack; *tc && *tc != c; tc = &(*tc)->snext);
-    *tc = c->snext;
+    if (c->sprev)
+        c->sprev->snext = c->snext;
+    else if (c->mon->stack == c)
+        c->mon->stack = c->snext;
+    if (c->snext)
+        c->snext->sprev = c->sprev;
+    c->sprev = c->snext = NULL;
 }
 
+/* Exchange the places of two clients of the same monitor in the tiling order. */
 void
-drawbar(Monitor *m) {
-    if (!showbar || !m->barhwnd) return;
+swap(Client *a, Client *b) {
+    Client *ap = a->prev, *an = a->next, *bp = b->prev, *bn = b->next;
 
-    dc.hdc = GetWindowDC(m->barhwnd);
-    dc.h = m->bh;
+    if (a == b)
+        return;
+    if (an == b) {
+        b->prev = ap;
+        b->next = a;
+        a->prev = b;
+        a->next = bn;
+    } else if (bn == a) {
+        a->prev = bp;
+        a->next = b;
+        b->prev = a;
+        b->next = an;
+    } else {
+        a->prev = bp;
+        a->next = bn;
+        b->prev = ap;
+        b->next = an;
+    }
+    if (a->prev)
+        a->prev->next = a;
+    else
+        a->mon->clients = a;
+    if (a->next)
+        a->next->prev = a;
+    if (b->prev)
+        b->prev->next = b;
+    else
+        b->mon->clients = b;
+    if (b->next)
+        b->next->prev = b;
+}
 
-    int x;
-    unsigned int i, occ = 0, urg = 0;
-    unsigned long *col;
+/* The bar is made of segments which are only repainted when what they show
+ * changed since the last paint, or when they were explicitly marked dirty. */
+static bool
+segchanged(Monitor *m, unsigned int s, int x, int w, bool changed) {
+    Segment *g = &m->seg[s];
+
+    if (g->x != x || g->w != w) {
+        g->x = x;
+        g->w = w;
+        changed = true;
+    }
+    return changed || g->dirty;
+}
+
+static void
+segpainted(Monitor *m, unsigned int s, int *l, int *r) {
+    Segment *g = &m->seg[s];
+
+    g->dirty = false;
+    g->version++;
+    barrepaints[s]++;
+    *l = MIN(*l, g->x);
+    *r = MAX(*r, g->x + g->w);
+}
+
+void
+dirtybar(Monitor *m, unsigned int s) {
+    m->seg[s].dirty = true;
+}
+
+void
+drawbar(Monitor *m) {
+    HDC hdc;
+    int x, l, r;
+    unsigned int i, occ = 0, urg = 0, cur, mark, diff;
+    unsigned long *col;
+    const wchar_t *title = NULL;
+    unsigned int flags = 0;
+    Layout *layout;
     Client *c;
 
-    /* set status text */
-    memcpy(stext, NAME, sizeof(stext));
+    if (!showbar || !m->barhwnd) return;
+    TRACESTART(t);
+    if (!drawbuffer(m)) {
+        TRACEEND(t, L"drawbar", NULL, m);
+        return;
+    }
+
+    dc.hdc = m->bardc;
+    dc.h = m->bh;
+    l = m->ww;
+    r = 0;
 
     /* compute occupancy only for this monitor */
-    for (c = clients; c; c = c->next) {
-        if (c->mon != m) continue;
+    for (c = m->clients; c; c = c->next) {
         occ |= c->tags;
         if (c->isurgent)
             urg |= c->tags;
     }
-
-    dc.x = 0;
-    for (i = 0; i < LENGTH(tags); i++) {
-        dc.w = tagw[i];
-        unsigned int cur_tagset = m->tagset[m->seltags];
-        col = cur_tagset & 1 << i ? dc.sel : dc.norm;
-        drawtext(tags[i], col, urg & 1 << i);
-        drawsquare(sel && sel->mon == m && sel->tags & 1 << i, occ & 1 << i, urg & 1 << i, col);
-        dc.x += dc.w;
+    cur = m->tagset[m->seltags];
+    mark = (sel && sel->mon == m) ? sel->tags : 0;
+
+    /* tags, only the cells whose state changed */
+    x = 0;
+    for (i = 0; i < LENGTH(tags); i++)
+        x += tagw[i];
+    diff = (cur ^ m->bartags[0]) | (occ ^ m->bartags[1]) | (urg ^ m->bartags[2]) | (mark ^ m->bartags[3]);
+    if (segchanged(m, SegTags, 0, x, false))
+        diff = TAGMASK;
+    if (diff & TAGMASK) {
+        for (dc.x = 0, i = 0; i < LENGTH(tags); dc.x += dc.w, i++) {
+            dc.w = tagw[i];
+            if (!(diff & 1 << i))
+                continue;
+            col = cur & 1 << i ? dc.sel : dc.norm;
+            drawtext(tags[i], col, urg & 1 << i);
+            drawsquare(mark & 1 << i, occ & 1 << i, urg & 1 << i, col);
+        }
+        segpainted(m, SegTags, &l, &r);
     }
+    m->bartags[0] = cur;
+    m->bartags[1] = occ;
+    m->bartags[2] = urg;
+    m->bartags[3] = mark;
+
+    /* layout symbol */
+    layout = mon_get_layout(m, m->sellt);
     if (m->blw > 0) {
-        dc.w = m->blw;
-        drawtext(mon_get_layout(m, m->sellt)->symbol, dc.norm, false);
-        x = dc.x + dc.w;
+        if (segchanged(m, SegLayout, x, m->blw, layout != m->barlayout)) {
+            dc.x = x;
+            dc.w = m->blw;
+            drawtext(layout->symbol, dc.norm, false);
+            segpainted(m, SegLayout, &l, &r);
+        }
+        x += m->blw;
     }
-    else
-        x = dc.x;
+    m->barlayout = layout;
 
-    dc.w = TEXTW(stext);
+    /* status, measured here where the bar font is selected */
+    if (stextmeasured != stextversion) {
+        stextw = TEXTW(stext);
+        stextmeasured = stextversion;
+    }
+    dc.w = stextw;
     dc.x = m->ww - dc.w;
     if (dc.x < x) {
         dc.x = x;
         dc.w = m->ww - x;
     }
-    drawtext(stext, dc.norm, false);
+    if (segchanged(m, SegStatus, dc.x, dc.w, stextversion != m->barstatus)) {
+        drawstatus();
+        segpainted(m, SegStatus, &l, &r);
+    }
+    m->barstatus = stextversion;
 
+    /* title of the selected client */
     if ((dc.w = dc.x - x) > m->bh) {
         dc.x = x;
         if (sel && sel->mon == m) {
-            drawtext(getclienttitle(sel->hwnd), dc.sel, false);
-            drawsquare(sel->isfixed, sel->isfloating, false, dc.sel);
+            title = sel->title;
+            flags = 1 | sel->isfixed << 1 | sel->isfloating << 2;
+        }
+        if (segchanged(m, SegTitle, dc.x, dc.w, flags != m->barflags
+                || (title && wcsncmp(title, m->bartitle, LENGTH(m->bartitle) - 1)))) {
+            if (title) {
+                drawtext(title, dc.sel, false);
+                drawsquare(sel->isfixed, sel->isfloating, false, dc.sel);
+                wcsncpy(m->bartitle, title, LENGTH(m->bartitle) - 1);
+            } else {
+                drawtext(NULL, dc.norm, false);
+            }
+            m->barflags = flags;
+            segpainted(m, SegTitle, &l, &r);
         }
-        else
-            drawtext(NULL, dc.norm, false);
     }
 
-    ReleaseDC(m->barhwnd, dc.hdc);
+    if (r > l) {
+        hdc = GetDC(m->barhwnd);
+        BitBlt(hdc, l, 0, r - l, m->barbh, m->bardc, l, 0, SRCCOPY);
+        ReleaseDC(m->barhwnd, hdc);
+    }
+    TRACEEND(t, L"drawbar", NULL, m);
+}
+
+/* (Re)creates the off-screen DIB section of a bar, only when its size changed.
+ * The font and background mode stay selected into it for its whole life. */
+bool
+drawbuffer(Monitor *m) {
+    BITMAPINFO bi = { 0 };
+    void *bits;
+    HDC hdc;
+
+    if (m->bardc && m->barbw == m->ww && m->barbh == m->bh)
+        return true;
+    freebuffer(m);
+    if (m->ww <= 0 || m->bh <= 0)
+        return false;
+
+    bi.bmiHeader.biSize = sizeof(bi.bmiHeader);
+    bi.bmiHeader.biWidth = m->ww;
+    bi.bmiHeader.biHeight = -m->bh; /* top-down */
+    bi.bmiHeader.biPlanes = 1;
+    bi.bmiHeader.biBitCount = 32;
+    bi.bmiHeader.biCompression = BI_RGB;
+
+    hdc = GetDC(m->barhwnd);
+    m->bardc = CreateCompatibleDC(hdc);
+    m->barbmp = CreateDIBSection(hdc, &bi, DIB_RGB_COLORS, &bits, NULL, 0);
+    ReleaseDC(m->barhwnd, hdc);
+    if (!m->bardc || !m->barbmp) {
+        freebuffer(m);
+        return false;
+    }
+
+    m->baroldbmp = SelectObject(m->bardc, m->barbmp);
+    SelectObject(m->bardc, font);
+    SetBkMode(m->bardc, TRANSPARENT);
+    m->barbw = m->ww;
+    m->barbh = m->bh;
+    for (unsigned int i = 0; i < SegLast; i++)
+        dirtybar(m, i);
+    return true;
+}
+
+void
+freebuffer(Monitor *m) {
+    if (m->bardc) {
+        if (m->baroldbmp)
+            SelectObject(m->bardc, m->baroldbmp);
+        DeleteDC(m->bardc);
+    }
+    if (m->barbmp)
+        DeleteObject(m->barbmp);
+    m->bardc = NULL;
+    m->barbmp = NULL;
+    m->baroldbmp = NULL;
+    m->barbw = m->barbh = 0;
 }
 
 void
 drawsquare(bool filled, bool empty, bool invert, unsigned long col[ColLast]) {
     static int size = 5;
     RECT r = { .left = dc.x + 1, .top = dc.y + 1, .right = dc.x + size, .bottom = dc.y + size };
+    int s = (col == dc.norm) ? 0 : 1;
 
-    HBRUSH brush = CreateSolidBrush(col[invert ? ColBG : ColFG]);
-    SelectObject(dc.hdc, brush);
-
-    if (filled) {
-        FillRect(dc.hdc, &r, brush);
-    } else if (empty) {
-        FillRect(dc.hdc, &r, brush);
-    }
-    DeleteObject(brush);
+    if (filled || empty)
+        FillRect(dc.hdc, &r, invert ? dc.brush[s] : dc.fgbrush[s]);
 }
 
 void
 drawtext(const wchar_t *text, unsigned long col[ColLast], bool invert) {
     RECT r = { .left = dc.x, .top = dc.y, .right = dc.x + dc.w, .bottom = dc.y + dc.h };
-    HPEN pen;
-    HBRUSH brush;
+    int s = (col == dc.norm) ? 0 : 1;
 
-    if (!invert) {
-        pen = dc.pen;
-        brush = (col == dc.norm) ? dc.brush[0] : dc.brush[1];
-    } else {
-        pen = CreatePen(PS_SOLID, borderpx, selbordercolor);
-        brush = CreateSolidBrush(col[ColFG]);
-    }
-
-    SelectObject(dc.hdc, pen);
-    SelectObject(dc.hdc, brush);
-    FillRect(dc.hdc, &r, brush);
-
-    if (invert) {
-        DeleteObject(brush);
-        DeleteObject(pen);
-    }
-
-    SetBkMode(dc.hdc, TRANSPARENT);
+    FillRect(dc.hdc, &r, invert ? dc.fgbrush[s] : dc.brush[s]);
     SetTextColor(dc.hdc, col[invert ? ColBG : ColFG]);
-
-    if (!font) {
-        font = CreateFontW(fontsize, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, fontname);
-        if (!font)
-            font = (HFONT)GetStockObject(SYSTEM_FONT);
-    }
-    SelectObject(dc.hdc, font);
-
     DrawTextW(dc.hdc, text, -1, &r, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
 }
+/* Draws stext into the status segment, one run per color of the markup. */
+void
+drawstatus(void) {
+    RECT r = { .left = dc.x, .top = dc.y, .right = dc.x + dc.w, .bottom = dc.y + dc.h };
+    unsigned int i, j, len = (unsigned int)wcslen(stext);
+    unsigned long *col;
+    SIZE size;
+    bool invert;
+    int s;
+
+    FillRect(dc.hdc, &r, dc.brush[0]);
+    r.left += textmargin / 2;
+    for (i = 0; i < len && r.left < dc.x + dc.w; i = j) {
+        for (j = i + 1; j < len && stextcol[j] == stextcol[i]; j++);
+        col = stextcol[i] == StatusSel ? dc.sel : dc.norm;
+        invert = stextcol[i] == StatusInvert;
+        s = (col == dc.norm) ? 0 : 1;
+        GetTextExtentPoint32W(dc.hdc, stext + i, j - i, &size);
+        r.right = MIN(r.left + size.cx, dc.x + dc.w);
+        FillRect(dc.hdc, &r, invert ? dc.fgbrush[s] : dc.brush[s]);
+        SetTextColor(dc.hdc, col[invert ? ColBG : ColFG]);
+        DrawTextW(dc.hdc, stext + i, j - i, &r, DT_LEFT | DT_VCENTER | DT_SINGLELINE);
+        r.left = r.right;
+    }
+}
+
 void
 eprint(bool premortem, const wchar_t *errstr, ...) {
     va_list ap;
@@ -615,8 +1856,10 @@ cleanup:
 
 void
 setselected(Client *c) {
+    Client *old = sel;
+
     if (!c || !ISVISIBLE(c))
-        for (c = stack; c && (!ISVISIBLE(c) || c->mon != selmon); c = c->snext);
+        for (c = selmon ? selmon->stack : NULL; c && (!ISVISIBLE(c) || c->isminimized); c = c->snext);
     if (sel && sel != c)
         drawborder(sel, normbordercolor);
     if (!roundcorners) nocorners(sel);
@@ -628,34 +1871,49 @@ setselected(Client *c) {
         drawborder(c, selbordercolor);
     }
     sel = c;
-    for (Monitor *m = mons; m; m = m->next) drawbar(m);
+    selections++;
+    /* only the bars showing the old and the new selection can change */
+    if (holdflush) {
+        if (old)
+            dirtymon(old->mon, DirtyBar);
+        if (c)
+            dirtymon(c->mon, DirtyBar);
+        return;
+    }
+    if (old && old->mon)
+        drawbar(old->mon);
+    if (c && c->mon && (!old || c->mon != old->mon))
+        drawbar(c->mon);
 }
 
 void
 focus(Client *c) {
     setselected(c);
     if (sel)
-        SetForegroundWindow(sel->hwnd);
+        pf->foreground(sel->hwnd);
 }
 
 void
 focusstack(const Arg *arg) {
     Client *c = NULL, *i;
 
-    if (!sel)
+    if (!sel || !selmon)
         return;
-    if (arg->i > 0) {
-        for (c = sel->next; c && (!ISFOCUSABLE(c) || c->mon != selmon); c = c->next);
+    if (sel->mon != selmon) {
+        for (c = selmon->clients; c && !ISFOCUSABLE(c); c = c->next);
+    }
+    else if (arg->i > 0) {
+        for (c = sel->next; c && !ISFOCUSABLE(c); c = c->next);
         if (!c)
-            for (c = clients; c && (!ISFOCUSABLE(c) || c->mon != selmon); c = c->next);
+            for (c = selmon->clients; c && !ISFOCUSABLE(c); c = c->next);
     }
     else {
-        for (i = clients; i != sel; i = i->next)
-            if (ISFOCUSABLE(i) && i->mon == selmon)
+        for (i = selmon->clients; i != sel; i = i->next)
+            if (ISFOCUSABLE(i))
                 c = i;
         if (!c)
             for (; i; i = i->next)
-                if (ISFOCUSABLE(i) && i->mon == selmon)
+                if (ISFOCUSABLE(i))
                     c = i;
     }
     if (c) {
@@ -664,52 +1922,106 @@ focusstack(const Arg *arg) {
     }
 }
 
-Client *
-managechildwindows(Client *p) {
-    Client *c, *t;
-    EnumChildWindows(p->hwnd, scan, 0);
-    for (c = clients; c; ) {
-        if (c->parent == p->hwnd) {
-            if (!c->isalive && !IsWindowVisible(c->hwnd)) {
-                t = c->next;
-                unmanage(c);
-                c = t;
-                continue;
+/* The HWND -> Client index is an open addressed hash table with linear
+ * probing. Deletion shifts the following entries back instead of leaving
+ * tombstones, so lookups never degrade after heavy window churn. */
+static unsigned int
+hashslot(HWND hwnd) {
+    /* handles are multiples of 2 or 4, fibonacci hashing spreads them */
+    unsigned long long h = (unsigned long long)(UINT_PTR)hwnd * 0x9E3779B97F4A7C15ULL;
+    return (unsigned int)(h >> 32) & (chashcap - 1);
+}
+
+static void
+hashinsert(Client *c) {
+    unsigned int i;
+
+    if ((chashlen + 1) * 2 > chashcap) {
+        Client **old = chash;
+        unsigned int oldcap = chashcap;
+
+        chashcap = chashcap ? chashcap * 2 : 64;
+        if (!(chash = calloc(chashcap, sizeof(Client *))))
+            die(L"fatal: could not calloc() %u bytes for client index\n", (unsigned)(chashcap * sizeof(Client *)));
+        for (i = 0; i < oldcap; i++) {
+            if (old[i]) {
+                unsigned int j = hashslot(old[i]->hwnd);
+                while (chash[j])
+                    j = (j + 1) & (chashcap - 1);
+                chash[j] = old[i];
             }
-            c->isalive = false;
         }
-        c = c->next;
+        free(old);
+    }
+
+    for (i = hashslot(c->hwnd); chash[i]; i = (i + 1) & (chashcap - 1))
+        if (chash[i] == c)
+            return;
+    chash[i] = c;
+    chashlen++;
+}
+
+static void
+hashremove(Client *c) {
+    unsigned int i, j, k;
+
+    if (!chashcap)
+        return;
+    for (i = hashslot(c->hwnd); chash[i] != c; i = (i + 1) & (chashcap - 1))
+        if (!chash[i])
+            return;
+    chash[i] = NULL;
+    chashlen--;
+
+    /* move back entries whose probe sequence crossed the freed slot */
+    for (j = (i + 1) & (chashcap - 1); chash[j]; j = (j + 1) & (chashcap - 1)) {
+        k = hashslot(chash[j]->hwnd);
+        if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+            chash[i] = chash[j];
+            chash[j] = NULL;
+            i = j;
+        }
     }
-    return nextchild(p, clients);
 }
 
 Client *
 getclient(HWND hwnd) {
-    Client *c;
-    for (c = clients; c; c = c->next)
-        if (c->hwnd == hwnd)
-            return c;
+    unsigned int i;
+
+    if (!chashlen)
+        return NULL;
+    for (i = hashslot(hwnd); chash[i]; i = (i + 1) & (chashcap - 1))
+        if (chash[i]->hwnd == hwnd)
+            return chash[i];
     return NULL;
 }
 
 LPWSTR
 getclientclassname(HWND hwnd) {
     static wchar_t buf[500];
-    GetClassNameW(hwnd, buf, (int)LENGTH(buf));
+    if (!pf->classname(hwnd, buf, (int)LENGTH(buf)))
+        buf[0] = L'\0';
     return buf;
 }
 
 LPWSTR
 getclienttitle(HWND hwnd) {
     static wchar_t buf[500];
-    GetWindowTextW(hwnd, buf, (int)LENGTH(buf));
+    if (!pf->title(hwnd, buf, (int)LENGTH(buf)))
+        buf[0] = L'\0';
     return buf;
 }
 
+void
+updatetitle(Client *c) {
+    if (!pf->title(c->hwnd, c->title, (int)LENGTH(c->title)))
+        c->title[0] = L'\0';
+}
+
 HWND
 getroot(HWND hwnd) {
-    HWND parent, deskwnd = GetDesktopWindow();
-    while ((parent = GetWindow(hwnd, GW_OWNER)) != NULL && deskwnd != parent)
+    HWND parent, deskwnd = pf->desktop();
+    while ((parent = pf->owner(hwnd)) != NULL && deskwnd != parent)
         hwnd = parent;
     return hwnd;
 }
@@ -718,21 +2030,21 @@ void
 grabkeys(HWND hwnd) {
     int i;
     for (i = 0; i < LENGTH(keys); i++) {
-        RegisterHotKey(hwnd, i, keys[i].mod, keys[i].key);
+        pf->registerhotkey(hwnd, i, keys[i].mod, keys[i].key);
     }
 }
 
 bool
-iscloaked(HWND hwnd) {
-    int cloaked_val;
-    HRESULT h_res = DwmGetWindowAttribute(hwnd, DWMWA_CLOAKED, &cloaked_val, sizeof(cloaked_val));
-    if (h_res != S_OK)
-        cloaked_val = 0;
-    return cloaked_val ? true : false;
+ismanageable(HWND hwnd) {
+    TRACESTART(t);
+    bool r = checkmanageable(hwnd);
+
+    TRACEEND(t, L"ismanageable", hwnd, NULL);
+    return r;
 }
 
 bool
-ismanageable(HWND hwnd) {
+checkmanageable(HWND hwnd) {
     HWND parent;
     int style, exstyle;
     bool pok, istool, isapp;
@@ -766,9 +2078,9 @@ ismanageable(HWND hwnd) {
     if (getclient(hwnd))
         return true;
 
-    parent = GetParent(hwnd);
-    style = GetWindowLong(hwnd, GWL_STYLE);
-    exstyle = GetWindowLong(hwnd, GWL_EXSTYLE);
+    parent = pf->parent(hwnd);
+    style = pf->style(hwnd, GWL_STYLE);
+    exstyle = pf->style(hwnd, GWL_EXSTYLE);
     pok = (parent != 0 && ismanageable(parent));
     istool = exstyle & WS_EX_TOOLWINDOW;
     isapp = exstyle & WS_EX_APPWINDOW;
@@ -776,7 +2088,8 @@ ismanageable(HWND hwnd) {
     if (pok && !getclient(parent))
         manage(parent);
 
-    if (GetWindowTextLength(hwnd) == 0) {
+    title = getclienttitle(hwnd);
+    if (!title[0]) {
         if (!isapp && !(style & WS_CAPTION))
             return false;
     }
@@ -785,11 +2098,10 @@ ismanageable(HWND hwnd) {
         return false;
     if (exstyle & WS_EX_NOACTIVATE)
         return false;
-    if (iscloaked(hwnd))
+    if (pf->cloaked(hwnd))
         return false;
 
     classname = getclientclassname(hwnd);
-    title = getclienttitle(hwnd);
 
     if (wcsstr(classname, L"Windows.UI.Core.CoreWindow")) {
         for (i = 0; i < LENGTH(titles); i++)
@@ -801,7 +2113,7 @@ ismanageable(HWND hwnd) {
         if (wcsstr(classname, classes[i]))
             return false;
 
-    if ((parent == 0 && IsWindowVisible(hwnd)) || pok) {
+    if ((parent == 0 && pf->visible(hwnd)) || pok) {
         if ((!istool && parent == 0) || (istool && pok))
             return true;
         if (isapp && parent != 0)
@@ -814,23 +2126,774 @@ void
 killclient(const Arg *arg) {
     if (!sel)
         return;
-    PostMessage(sel->hwnd, WM_CLOSE, 0, 0);
+    pf->close(sel->hwnd);
 }
 
 static void
 update_client_monitor(Client *c) {
     Monitor *m = monitor_from_hwnd(c->hwnd);
     if (m && m != c->mon) {
+        dirtymon(c->mon, DirtyLayout | DirtyBar);
+        detach(c);
+        detachstack(c);
         c->mon = m;
+        c->framevalid = false;  /* the new monitor may have another DPI */
+        attach(c);
+        attachstack(c);
+        dirtyclient(c);
+        dirtymon(m, DirtyLayout | DirtyBar);
+    }
+}
+
+static unsigned int
+strhash(const wchar_t *s, size_t len) {
+    unsigned int h = 2166136261u; /* FNV-1a */
+
+    while (len--)
+        h = (h ^ *s++) * 16777619u;
+    return h;
+}
+
+/* Copies s into the string arena once, equal strings share one copy. */
+static const wchar_t *
+intern(const wchar_t *s, size_t len) {
+    unsigned int i, j, cap;
+    const wchar_t **t;
+    void **blocks;
+    wchar_t *p;
+    size_t n;
+
+    if ((nimages + 1) * 2 > imagescap) {
+        cap = imagescap ? imagescap * 2 : 64;
+        if (!(t = calloc(cap, sizeof(wchar_t *))))
+            die(L"fatal: could not calloc() %u bytes for interned strings\n", (unsigned)(cap * sizeof(wchar_t *)));
+        for (i = 0; i < imagescap; i++) {
+            if (images[i]) {
+                for (j = strhash(images[i], wcslen(images[i])) & (cap - 1); t[j]; j = (j + 1) & (cap - 1));
+                t[j] = images[i];
+            }
+        }
+        free(images);
+        images = t;
+        imagescap = cap;
+    }
+
+    for (i = strhash(s, len) & (imagescap - 1); images[i]; i = (i + 1) & (imagescap - 1))
+        if (!wcsncmp(images[i], s, len) && !images[i][len])
+            return images[i];
+
+    if (arena.used + len + 1 > arena.size) {
+        n = MAX(len + 1, 8192);
+        if (!(p = malloc(n * sizeof(wchar_t))) || !(blocks = realloc(arenablocks, (narenablocks + 1) * sizeof(void *))))
+            die(L"fatal: could not malloc() %u bytes for string arena\n", (unsigned)(n * sizeof(wchar_t)));
+        arenablocks = blocks;
+        arenablocks[narenablocks++] = p;
+        arena.buf = p;
+        arena.used = 0;
+        arena.size = n;
+        arenabytes += n * sizeof(wchar_t);
+    }
+    p = arena.buf + arena.used;
+    memcpy(p, s, len * sizeof(wchar_t));
+    p[len] = L'\0';
+    arena.used += len + 1;
+    arenaused += (len + 1) * sizeof(wchar_t);
+    nimages++;
+    return images[i] = p;
+}
+
+/* Looks up the process of a new client by PID and creation time. The PID
+ * alone may belong to an exited process whose entry is still referenced,
+ * so an entry of another instance is a miss. */
+Process *
+findprocess(DWORD pid, ULONGLONG created) {
+    Process *p;
+
+    for (p = procs[pid % LENGTH(procs)]; p; p = p->next) {
+        if (p->pid == pid && p->created == created) {
+            p->refs++;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/* Looks up the process of a new client by PID alone. An entry is evicted
+ * with the last managed window of its process, and the PID of a process
+ * with a window left can't have been reused, so a hit is that process and
+ * costs neither a system call nor an allocation. */
+Process *
+liveprocess(DWORD pid) {
+    Process *p;
+
+    for (p = procs[pid % LENGTH(procs)]; p; p = p->next) {
+        if (p->pid == pid && p->refs) {
+            p->refs++;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+Process *
+addprocess(DWORD pid, ULONGLONG created, const wchar_t *image, size_t len) {
+    Process *p;
+
+    if ((p = freeprocs))
+        freeprocs = p->next;
+    else if (!(p = malloc(sizeof(Process))))
+        die(L"fatal: could not malloc() %u bytes for process\n", (unsigned)sizeof(Process));
+    p->pid = pid;
+    p->created = created;
+    p->image = intern(image, len);
+    p->refs = 1;
+    p->next = procs[pid % LENGTH(procs)];
+    procs[pid % LENGTH(procs)] = p;
+    nprocs++;
+    return p;
+}
+
+/* Runs on a worker thread, touches nothing but the query. */
+static void
+runquery(Query *q) {
+    DWORD len = q->imagecap;
+
+    q->imagelen = 0;
+    if (len && pf->processimage(q->pid, q->image, &len, &q->created))
+        q->imagelen = len;
+    q->style = pf->style(q->hwnd, GWL_STYLE);
+    q->exstyle = pf->style(q->hwnd, GWL_EXSTYLE);
+    q->hasframe = pf->frameinsets(q->hwnd, &q->insets);
+}
+
+static DWORD WINAPI
+worker(LPVOID arg) {
+    Query *q;
+
+    (void)arg;
+    for (;;) {
+        AcquireSRWLockExclusive(&queries.lock);
+        while (!queries.jobs && !queries.quit)
+            SleepConditionVariableSRW(&queries.cv, &queries.lock, INFINITE, 0);
+        if (queries.quit) {
+            ReleaseSRWLockExclusive(&queries.lock);
+            return 0;
+        }
+        q = queries.jobs;
+        if (!(queries.jobs = q->next))
+            queries.jobstail = &queries.jobs;
+        ReleaseSRWLockExclusive(&queries.lock);
+
+        runquery(q);
+
+        /* once quit is set the event and the lists may be gone */
+        AcquireSRWLockExclusive(&queries.lock);
+        if (queries.quit) {
+            ReleaseSRWLockExclusive(&queries.lock);
+            free(q);
+            return 0;
+        }
+        q->next = queries.done;
+        queries.done = q;
+        SetEvent(queries.event);
+        ReleaseSRWLockExclusive(&queries.lock);
+    }
+}
+
+/* Called on the feed thread. Only a changed line wakes the UI thread, and
+ * only if it hasn't been woken for an earlier one yet. */
+void
+publishstatus(const char *line) {
+    wchar_t w[LENGTH(feed.text)];
+    bool post = false;
+    int len, units = 0, n;
+
+    if (!MultiByteToWideChar(CP_UTF8, 0, line, -1, w, (int)LENGTH(w))) {
+        if (GetLastError() != ERROR_INSUFFICIENT_BUFFER)
+            return;
+        /* too long, keep the characters that fit, four byte ones take two units */
+        for (len = 0; line[len]; len++) {
+            if (((unsigned char)line[len] & 0xc0) == 0x80)
+                continue;
+            n = (unsigned char)line[len] >= 0xf0 ? 2 : 1;
+            if (units + n > (int)LENGTH(w) - 1)
+                break;
+            units += n;
+        }
+        if (!(n = MultiByteToWideChar(CP_UTF8, 0, line, len, w, (int)LENGTH(w) - 1)))
+            return;
+        w[n] = L'\0';
+    }
+    AcquireSRWLockExclusive(&feed.lock);
+    if (wcscmp(w, feed.text)) {
+        wcscpy(feed.text, w);
+        post = !feed.posted;
+        feed.posted = true;
+    }
+    ReleaseSRWLockExclusive(&feed.lock);
+    if (post)
+        PostMessage(dwmhwnd, WM_STATUSFEED, 0, 0);
+}
+
+/* A pipe is read as a stream of lines, each one an update. A file is
+ * checked every statuspoll ms and the last line in its tail shown, so a
+ * log that only grows can be the feed. */
+static DWORD WINAPI
+feedthread(LPVOID arg) {
+    static char buf[1024], line[1024];
+    WIN32_FILE_ATTRIBUTE_DATA fa;
+    FILETIME written = { 0 };
+    LARGE_INTEGER size, off;
+    unsigned int n = 0;
+    DWORD i, got;
+    HANDLE h;
+
+    (void)arg;
+    while (!feed.quit) {
+        if (feed.pipe) {
+            if (!ConnectNamedPipe(feed.pipe, NULL) && GetLastError() != ERROR_PIPE_CONNECTED) {
+                DisconnectNamedPipe(feed.pipe);
+                continue;
+            }
+            while (!feed.quit && ReadFile(feed.pipe, buf, sizeof(buf), &got, NULL)) {
+                for (i = 0; i < got; i++) {
+                    if (buf[i] == '\n') {
+                        line[n] = '\0';
+                        publishstatus(line);
+                        n = 0;
+                    } else if (buf[i] != '\r' && n < sizeof(line) - 1) {
+                        line[n++] = buf[i];
+                    }
+                }
+            }
+            n = 0;
+            DisconnectNamedPipe(feed.pipe);
+            continue;
+        }
+        if (GetFileAttributesExW(statusfeed, GetFileExInfoStandard, &fa)
+        && CompareFileTime(&fa.ftLastWriteTime, &written)) {
+            written = fa.ftLastWriteTime;
+            h = CreateFileW(statusfeed, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL, OPEN_EXISTING, 0, NULL);
+            if (h != INVALID_HANDLE_VALUE) {
+                off.QuadPart = 0;
+                if (GetFileSizeEx(h, &size) && size.QuadPart > (LONGLONG)sizeof(buf) - 1)
+                    off.QuadPart = size.QuadPart - (sizeof(buf) - 1);
+                if (SetFilePointerEx(h, off, NULL, FILE_BEGIN)
+                && ReadFile(h, buf, sizeof(buf) - 1, &got, NULL)) {
+                    /* the last line that isn't empty */
+                    while (got && (buf[got - 1] == '\n' || buf[got - 1] == '\r'))
+                        got--;
+                    buf[got] = '\0';
+                    for (i = got; i && buf[i - 1] != '\n'; i--);
+                    /* unless it began before the tail, then it is cut */
+                    if (i || !off.QuadPart)
+                        publishstatus(buf + i);
+                }
+                CloseHandle(h);
+            }
+        }
+        WaitForSingleObject(feed.stop, statuspoll);
+    }
+    return 0;
+}
+
+void
+startstatusfeed(void) {
+    DEVMODEW dm = { .dmSize = sizeof(DEVMODEW) };
+
+    if (!statusfeed)
+        return;
+    InitializeSRWLock(&feed.lock);
+    wcscpy(feed.text, stext);
+    /* no more than one update per refresh of the display */
+    feed.period = 1000 / 60;
+    if (EnumDisplaySettingsW(NULL, ENUM_CURRENT_SETTINGS, &dm) && dm.dmDisplayFrequency > 1)
+        feed.period = 1000 / dm.dmDisplayFrequency;
+    if (!wcsncmp(statusfeed, L"\\\\.\\pipe\\", 9)) {
+        feed.pipe = CreateNamedPipeW(statusfeed, PIPE_ACCESS_INBOUND | FILE_FLAG_FIRST_PIPE_INSTANCE,
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            1, 0, 4096, 0, NULL);
+        if (feed.pipe == INVALID_HANDLE_VALUE) {
+            /* not fatal, the bar just keeps its text */
+            debug(L"could not create %ls\n", statusfeed);
+            feed.pipe = NULL;
+            return;
+        }
+    }
+    if (!(feed.stop = CreateEventW(NULL, TRUE, FALSE, NULL)))
+        die(L"Could not create status feed event");
+    if (!(feed.thread = CreateThread(NULL, 0, feedthread, NULL, 0, NULL)))
+        die(L"Could not create status feed thread");
+}
+
+/* Waits for the thread however long it takes, it uses the lock and posts
+ * to dwmhwnd until it is gone. quit stays set. */
+void
+stopstatusfeed(void) {
+    HANDLE h = INVALID_HANDLE_VALUE;
+
+    if (!feed.thread)
+        return;
+    feed.quit = 1;
+    SetEvent(feed.stop);
+    CancelSynchronousIo(feed.thread);
+    if (feed.pipe)  /* wakes ConnectNamedPipe() in case the cancel came too early */
+        h = CreateFileW(statusfeed, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    while (WaitForSingleObject(feed.thread, 100) == WAIT_TIMEOUT)
+        CancelSynchronousIo(feed.thread);
+    if (h != INVALID_HANDLE_VALUE)
+        CloseHandle(h);
+    CloseHandle(feed.thread);
+    CloseHandle(feed.stop);
+    if (feed.pipe)
+        CloseHandle(feed.pipe);
+    feed.thread = feed.stop = feed.pipe = NULL;
+}
+
+/* Takes the newest line of the feed, unless the last one was shown less
+ * than a display refresh ago, then STATUSTIMER comes back for it. */
+void
+takestatus(void) {
+    wchar_t text[LENGTH(feed.text)];
+    ULONGLONG now = GetTickCount64();
+
+    if (now - feed.shown < feed.period) {
+        SetTimer(dwmhwnd, STATUSTIMER, (UINT)(feed.period - (now - feed.shown)), NULL);
+        return;
     }
+    KillTimer(dwmhwnd, STATUSTIMER);
+    AcquireSRWLockExclusive(&feed.lock);
+    wcscpy(text, feed.text);
+    feed.posted = false;
+    ReleaseSRWLockExclusive(&feed.lock);
+    feed.shown = now;
+    setstatus(text);
+}
+
+/* ^n, ^s and ^i switch the rest of the text to normal, selected or
+ * inverted colors, ^^ is a caret. */
+void
+setstatus(const wchar_t *markup) {
+    wchar_t text[LENGTH(stext)];
+    unsigned char col[LENGTH(stext)], cur = StatusNorm;
+    unsigned int n = 0;
+    const wchar_t *p;
+    Monitor *m;
+
+    for (p = markup; *p && n < LENGTH(text) - 1; p++) {
+        if (*p == L'^') {
+            switch (p[1]) {
+            case L'n': cur = StatusNorm; p++; continue;
+            case L's': cur = StatusSel; p++; continue;
+            case L'i': cur = StatusInvert; p++; continue;
+            case L'^': p++; break;
+            }
+            /* anything else is shown as it is, caret included */
+        }
+        col[n] = cur;
+        text[n++] = *p;
+    }
+    text[n] = L'\0';
+    if (!wcscmp(text, stext) && !memcmp(col, stextcol, n))
+        return;
+    wcscpy(stext, text);
+    memcpy(stextcol, col, n);
+    stextversion++;
+    /* drawbar() repaints the status segment alone, unless its width moved the title */
+    for (m = mons; m; m = m->next)
+        dirtymon(m, DirtyBar);
+    flush();
+}
+
+static DWORD WINAPI
+cmdthread(LPVOID arg) {
+    static char buf[CMDSIZE];
+    Command cmd;
+    DWORD n;
+
+    (void)arg;
+    while (!cmdserver.quit) {
+        if (!ConnectNamedPipe(cmdserver.pipe, NULL) && GetLastError() != ERROR_PIPE_CONNECTED) {
+            /* a client that came and went already */
+            DisconnectNamedPipe(cmdserver.pipe);
+            continue;
+        }
+        if (cmdserver.quit)
+            break;
+        if (ReadFile(cmdserver.pipe, buf, sizeof(buf) - 1, &n, NULL)) {
+            buf[n] = '\0';
+            cmd.in = buf;
+            cmd.out[0] = '\0';
+            /* the commands run on the UI thread, like hotkeys do */
+            SendMessage(dwmhwnd, WM_PIPECOMMAND, 0, (LPARAM)&cmd);
+        } else if (GetLastError() == ERROR_MORE_DATA) {
+            snprintf(cmd.out, sizeof(cmd.out), "error: request longer than %u bytes\n", CMDSIZE - 1);
+        } else {
+            /* the client is gone or the read was cancelled, nobody to reply to */
+            DisconnectNamedPipe(cmdserver.pipe);
+            continue;
+        }
+        WriteFile(cmdserver.pipe, cmd.out, (DWORD)strlen(cmd.out), &n, NULL);
+        FlushFileBuffers(cmdserver.pipe);
+        DisconnectNamedPipe(cmdserver.pipe);
+    }
+    return 0;
+}
+
+void
+startcmdserver(void) {
+    if (!cmdpipe)
+        return;
+    /* fails if another process already holds the name */
+    cmdserver.pipe = CreateNamedPipeW(cmdpipe, PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE,
+        PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+        1, CMDSIZE, CMDSIZE, 0, NULL);
+    if (cmdserver.pipe == INVALID_HANDLE_VALUE) {
+        /* not fatal, hotkeys work without it */
+        debug(L"could not create %ls\n", cmdpipe);
+        cmdserver.pipe = NULL;
+        return;
+    }
+    if (!(cmdserver.thread = CreateThread(NULL, 0, cmdthread, NULL, 0, NULL)))
+        die(L"Could not create command thread");
+}
+
+/* The thread may be blocked in SendMessage() to us, so sent messages are
+ * handled while waiting for it. runcommands() refuses them by then, quit
+ * stays set for good. There is no giving up on the thread, a cancel that
+ * came before it blocked is repeated instead. */
+void
+stopcmdserver(void) {
+    HANDLE h;
+    MSG msg;
+    DWORD r;
+
+    if (!cmdserver.pipe)
+        return;
+    cmdserver.quit = 1;
+    if (cmdserver.thread) {
+        CancelSynchronousIo(cmdserver.thread);
+        /* wakes ConnectNamedPipe() in case the cancel came too early */
+        h = CreateFileW(cmdpipe, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+        while ((r = MsgWaitForMultipleObjects(1, &cmdserver.thread, FALSE, 100, QS_SENDMESSAGE)) != WAIT_OBJECT_0
+        && r != WAIT_FAILED) {
+            if (r == WAIT_OBJECT_0 + 1)
+                PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+            else
+                CancelSynchronousIo(cmdserver.thread);
+        }
+        if (h != INVALID_HANDLE_VALUE)
+            CloseHandle(h);
+        CloseHandle(cmdserver.thread);
+        cmdserver.thread = NULL;
+    }
+    CloseHandle(cmdserver.pipe);
+    cmdserver.pipe = NULL;
+}
+
+/* Splits off the next word of a command line, NULL at its end. */
+char *
+cmdtoken(char **s) {
+    char *t;
+
+    for (t = *s; *t == ' ' || *t == '\t' || *t == '\r'; t++);
+    if (!*t)
+        return NULL;
+    for (*s = t; **s && **s != ' ' && **s != '\t' && **s != '\r'; (*s)++);
+    if (**s)
+        *(*s)++ = '\0';
+    return t;
+}
+
+/* @0x1234 is a window handle, @class=... and @title=... the first client
+ * whose class or title contains the rest. */
+Client *
+cmdtarget(const char *t) {
+    wchar_t w[256];
+    const wchar_t *field;
+    char *end;
+    Monitor *m;
+    Client *c;
+    bool byclass = !strncmp(t, "class=", 6);
+
+    if (!byclass && strncmp(t, "title=", 6)) {
+        ULONG_PTR h = (ULONG_PTR)strtoull(t, &end, 0);
+        return *end ? NULL : getclient((HWND)h);
+    }
+    if (!MultiByteToWideChar(CP_UTF8, 0, t + 6, -1, w, (int)LENGTH(w)))
+        return NULL;
+    for (m = mons; m; m = m->next)
+        for (c = m->clients; c; c = c->next) {
+            field = byclass ? c->classname : c->title;
+            if (wcsstr(field, w))
+                return c;
+        }
+    return NULL;
+}
+
+/* Runs the commands of a request as one batch: either all of them parse
+ * and run, followed by one flush, or none runs. A command is
+ *     [@target] action [argument]
+ * and applies to the target instead of the selected client if one is given. */
+void
+runcommands(Command *cmd) {
+    static const struct {
+        const char *name;
+        void (*func)(const Arg *);
+        char arg;   /* u tag mask, i integer, f float, l index in layouts[], 0 none */
+        bool optional;
+    } actions[] = {
+        { "view",       view,       'u', true },
+        { "tag",        tag,        'u', false },
+        { "toggletag",  toggletag,  'u', false },
+        { "setlayout",  setlayout,  'l', true },
+        { "setmfact",   setmfact,   'f', false },
+        { "sendmon",    sendmon,    'i', false },
+        { "focusstack", focusstack, 'i', false },
+        { "zoom",       zoom,       0,   false },
+        { "killclient", killclient, 0,   false },
+    };
+    struct {
+        unsigned int action;
+        Arg arg;
+        Client *target;
+    } batch[CMDMAX];
+    unsigned int i, n = 0, line = 0;
+    char *l, *next, *tok, *end, *ctx;
+    Client *prevsel;
+    Monitor *prevmon;
+    unsigned int prevselections;
+    LONGLONG start, freq;
+    LARGE_INTEGER f;
+
+    if (cmdserver.quit) {
+        snprintf(cmd->out, sizeof(cmd->out), "error: shutting down\n");
+        return;
+    }
+    for (l = cmd->in; l; l = next) {
+        line++;
+        if ((next = strchr(l, '\n')))
+            *next++ = '\0';
+        ctx = l;
+        if (!(tok = cmdtoken(&ctx)))
+            continue;   /* blank line */
+        if (n == CMDMAX) {
+            snprintf(cmd->out, sizeof(cmd->out), "error: more than %u commands\n", CMDMAX);
+            return;
+        }
+        memset(&batch[n], 0, sizeof(batch[n]));
+        if (*tok == '@') {
+            if (!(batch[n].target = cmdtarget(tok + 1))) {
+                snprintf(cmd->out, sizeof(cmd->out), "error: line %u: no window %s\n", line, tok);
+                return;
+            }
+            tok = cmdtoken(&ctx);
+        }
+        for (i = 0; tok && i < LENGTH(actions) && strcmp(tok, actions[i].name); i++);
+        if (!tok || i == LENGTH(actions)) {
+            snprintf(cmd->out, sizeof(cmd->out), "error: line %u: unknown action\n", line);
+            return;
+        }
+        batch[n].action = i;
+        tok = cmdtoken(&ctx);
+        if (actions[i].arg && !tok && !actions[i].optional) {
+            snprintf(cmd->out, sizeof(cmd->out), "error: line %u: %s needs an argument\n", line, actions[i].name);
+            return;
+        }
+        end = NULL;
+        if (tok) {
+            switch (actions[i].arg) {
+            case 'u': batch[n].arg.ui = (unsigned int)strtoul(tok, &end, 0); break;
+            case 'i': batch[n].arg.i = (int)strtol(tok, &end, 0); break;
+            case 'f': batch[n].arg.f = (float)strtod(tok, &end); break;
+            case 'l': {
+                unsigned long k = strtoul(tok, &end, 0);
+                if (k >= LENGTH(layouts))
+                    end = tok;
+                else
+                    batch[n].arg.v = &layouts[k];
+                break;
+            }
+            }
+            if (!end || *end || cmdtoken(&ctx)) {
+                snprintf(cmd->out, sizeof(cmd->out), "error: line %u: bad argument\n", line);
+                return;
+            }
+        }
+        n++;
+    }
+
+    /* one arrange and one repaint for the whole batch */
+    start = profnow();
+    holdflush++;
+    for (i = 0; i < n; i++) {
+        prevsel = sel;
+        prevmon = selmon;
+        prevselections = selections;
+        if (batch[i].target) {
+            sel = batch[i].target;
+            selmon = sel->mon;
+        }
+        actions[batch[i].action].func(&batch[i].arg);
+        /* give the selection back unless the action focused something,
+         * zoom or focusstack may have focused the target itself */
+        if (batch[i].target && selections == prevselections && sel == batch[i].target) {
+            sel = prevsel;
+            selmon = prevmon;
+        }
+    }
+    holdflush--;
+    flush();
+    QueryPerformanceFrequency(&f);
+    freq = f.QuadPart;
+    snprintf(cmd->out, sizeof(cmd->out), "ok %u %.1f us\n", n, (profnow() - start) * 1e6 / (double)freq);
+}
+
+void
+startworkers(void) {
+    InitializeSRWLock(&queries.lock);
+    InitializeConditionVariable(&queries.cv);
+    queries.jobstail = &queries.jobs;
+    if (!(queries.event = CreateEventW(NULL, FALSE, FALSE, NULL)))
+        die(L"Could not create query event");
+    for (unsigned int i = 0; i < NWORKERS; i++)
+        if (!(queries.threads[i] = CreateThread(NULL, 0, worker, NULL, 0, NULL)))
+            die(L"Could not create worker thread");
+}
+
+/* A worker stuck in a hung process is abandoned, it frees its query and
+ * returns when it gets back. Past quit, it only takes the lock to read it,
+ * so those two stay as they are. */
+void
+stopworkers(void) {
+    Query *q, *next;
+    unsigned int i, n = 0;
+
+    if (!queries.event)
+        return;
+    AcquireSRWLockExclusive(&queries.lock);
+    queries.quit = true;
+    ReleaseSRWLockExclusive(&queries.lock);
+    WakeAllConditionVariable(&queries.cv);
+    for (i = 0; i < NWORKERS; i++)
+        if (queries.threads[i])
+            queries.threads[n++] = queries.threads[i];
+    if (n)
+        WaitForMultipleObjects(n, queries.threads, TRUE, 1000);
+    for (i = 0; i < n; i++)
+        CloseHandle(queries.threads[i]);
+    for (q = queries.jobs; q; q = next) {
+        next = q->next;
+        free(q);
+    }
+    for (q = queries.done; q; q = next) {
+        next = q->next;
+        free(q);
+    }
+    CloseHandle(queries.event);
+    queries.event = NULL;
+    queries.jobs = queries.done = NULL;
+    queries.jobstail = &queries.jobs;
+    memset(queries.threads, 0, sizeof(queries.threads));
+}
+
+void
+queuequery(Client *c) {
+    Query *q;
+    DWORD cap = c->proc ? 0 : MAX_PATH;
+    size_t size = sizeof(Query) + cap * sizeof(wchar_t);
+
+    if (!(q = calloc(1, size)))
+        die(L"fatal: could not calloc() %u bytes for query\n", (unsigned)size);
+    q->hwnd = c->hwnd;
+    q->pid = c->processid;
+    q->imagecap = cap;
+    c->querying = true;
+
+    AcquireSRWLockExclusive(&queries.lock);
+    *queries.jobstail = q;
+    queries.jobstail = &q->next;
+    ReleaseSRWLockExclusive(&queries.lock);
+    WakeConditionVariable(&queries.cv);
+}
+
+static void
+finishquery(Query *q) {
+    Client *c = getclient(q->hwnd);
+
+    /* the window is gone, or its handle was reused by another process */
+    if (!c || c->processid != q->pid)
+        return;
+    if (!c->framevalid) {
+        RECT *in = &q->insets;
+        bool moved = c->w && q->hasframe && (in->left || in->top || in->right || in->bottom);
+        int x = c->x, y = c->y, w = c->w, h = c->h;
+
+        /* it was placed before its invisible borders were known, record
+         * where it is while they still count as unknown */
+        if (moved && deferdepth)
+            placement(c);
+        c->style = q->style;
+        c->exstyle = q->exstyle;
+        c->hasframe = q->hasframe;
+        c->insets = q->insets;
+        c->framevalid = true;
+        if (moved) {
+            outerrect(c, &x, &y, &w, &h);
+            placewindow(c, x, y, w, h);
+        }
+    }
+    c->querying = false;
+    if (c->proc || !q->imagelen)
+        return;
+    if (!(c->proc = findprocess(q->pid, q->created)))
+        c->proc = addprocess(q->pid, q->created, q->image, q->imagelen);
+    if (!c->proc)
+        return;
+    c->processname = c->proc->image;
+    if (applyprocessrules(c)) {
+        dirtyclient(c);
+        dirtymon(c->mon, DirtyLayout | DirtyBar);
+    }
+}
+
+void
+completequeries(void) {
+    Query *q, *next;
+
+    AcquireSRWLockExclusive(&queries.lock);
+    q = queries.done;
+    queries.done = NULL;
+    ReleaseSRWLockExclusive(&queries.lock);
+    beginplacement();
+    for (; q; q = next) {
+        next = q->next;
+        finishquery(q);
+        free(q);
+    }
+    commitplacement();
+    flush();
+}
+
+/* Evicts the process once its last managed window is gone. */
+void
+releaseprocess(Process *p) {
+    Process **pp;
+
+    if (!p || --p->refs)
+        return;
+    for (pp = &procs[p->pid % LENGTH(procs)]; *pp && *pp != p; pp = &(*pp)->next);
+    if (*pp)
+        *pp = p->next;
+    p->next = freeprocs;
+    freeprocs = p;
+    nprocs--;
 }
 
 Client *
 manage(HWND hwnd) {
     Client *c;
-    HANDLE hproc;
-    DWORD len;
-    wchar_t *buf;
     WINDOWINFO wi = { .cbSize = sizeof(WINDOWINFO) };
     static WINDOWPLACEMENT wp = {
         .length = sizeof(WINDOWPLACEMENT),
@@ -841,82 +2904,209 @@ manage(HWND hwnd) {
     if (c)
         return c;
 
-    if (!GetWindowInfo(hwnd, &wi))
+    TRACESTART(t);
+    if (!pf->windowinfo(hwnd, &wi)) {
+        TRACEEND(t, L"manage", hwnd, NULL);
         return NULL;
+    }
 
-    if (!(c = calloc(1, sizeof(Client))))
-        die(L"fatal: could not calloc() %u bytes for new client\n", (unsigned)sizeof(Client));
+    if (!(c = poolalloc(&clientpool)))
+        die(L"fatal: could not allocate %u bytes for new client\n", (unsigned)sizeof(Client));
 
     c->hwnd = hwnd;
-    c->threadid = GetWindowThreadProcessId(hwnd, NULL);
-    c->parent = GetParent(hwnd);
+    c->threadid = pf->windowthread(hwnd, &c->processid);
+    c->parent = pf->parent(hwnd);
     c->root = getroot(hwnd);
-    c->isalive = true;
     c->processname = L"";
-    c->iscloaked = iscloaked(hwnd);
+    if (!pf->classname(hwnd, c->classname, (int)LENGTH(c->classname)))
+        c->classname[0] = L'\0';
+    updatetitle(c);
+    c->iscloaked = false;   /* ismanageable() refuses cloaked windows */
     c->bw = 0;
 
     c->mon = monitor_from_hwnd(hwnd);
     if (!c->mon) c->mon = selmon ? selmon : mons;
-
-    GetWindowThreadProcessId(hwnd, &c->processid);
-    hproc = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, c->processid);
-    if (hproc) {
-        len = MAX_PATH;
-        buf = (wchar_t*)calloc(len, sizeof(wchar_t));
-        if (buf && QueryFullProcessImageNameW(hproc, 0, buf, &len)) {
-            c->processname = buf;
-        } else {
-            if (buf) free(buf);
-        }
-        CloseHandle(hproc);
+    if (!c->mon) {
+        poolfree(&clientpool, c);
+        TRACEEND(t, L"manage", hwnd, NULL);
+        return NULL;
     }
 
-    if (IsWindowVisible(hwnd))
-        SetWindowPlacement(hwnd, &wp);
+    if (pf->visible(hwnd))
+        pf->setplacement(hwnd, &wp);
 
     c->isfloating = (!(wi.dwStyle & WS_MINIMIZEBOX) && !(wi.dwStyle & WS_MAXIMIZEBOX));
 
-    c->ignoreborder = iscloaked(hwnd);
+    c->ignoreborder = c->iscloaked;
+
+    /* a known process is shared right away, so its rules apply now */
+    if ((c->proc = liveprocess(c->processid)))
+        c->processname = c->proc->image;
+    applyrules(c);
+
+    /* before any placement, which then goes without the frame insets
+     * instead of asking DWM here, finishquery() corrects it */
+    queuequery(c);
+
+    if (c->isfloating && pf->visible(hwnd)) {
+        resize(c, wi.rcWindow.left, wi.rcWindow.top,
+               wi.rcWindow.right - wi.rcWindow.left,
+               wi.rcWindow.bottom - wi.rcWindow.top);
+    }
+
+    attach(c);
+    attachstack(c);
+    hashinsert(c);
+    dirtyclient(c);
+    dirtymon(c->mon, DirtyLayout | DirtyBar);
+    TRACEEND(t, L"manage", hwnd, c->mon);
+    return c;
+}
+
+Client *
+nexttiled(Client *c) {
+    for (; c && (c->isfloating || c->isminimized || !ISVISIBLE(c)); c = c->next);
+    return c;
+}
+
+void
+quit(const Arg *arg) {
+    PostMessage(dwmhwnd, WM_CLOSE, 0, 0);
+}
+
+/* While flush() runs, window moves, shows and hides are collected here and
+ * committed in a single DeferWindowPos transaction, so a retile or a tag
+ * switch repaints once instead of once per window. Outside of it, they
+ * are applied immediately. */
+void
+beginplacement(void) {
+    deferdepth++;
+}
+
+static void
+setwindowpos(Client *c, int x, int y, int w, int h, UINT flags) {
+    arrstats.swpcalls++;
+    /* If the window can't be managed, we assign it as a floating window. */
+    if (!pf->setwindowpos(c->hwnd, HWND_TOP, x, y, w, h, SWP_NOACTIVATE | flags)
+    && !(flags & SWP_NOMOVE))
+        c->isfloating = true;
+}
+
+static Placement *
+placement(Client *c) {
+    Placement *p;
+
+    if (!c->placement) {
+        if (nplacements == placementscap) {
+            placementscap = placementscap ? placementscap * 2 : 32;
+            if (!(p = realloc(placements, placementscap * sizeof(Placement))))
+                die(L"fatal: could not realloc() %u bytes for placements\n", (unsigned)(placementscap * sizeof(Placement)));
+            placements = p;
+        }
+        p = &placements[nplacements++];
+        p->c = c;
+        p->ox = c->x;
+        p->oy = c->y;
+        p->ow = c->w;
+        p->oh = c->h;
+        outerrect(c, &p->ox, &p->oy, &p->ow, &p->oh);
+        p->x = p->ox;
+        p->y = p->oy;
+        p->w = p->ow;
+        p->h = p->oh;
+        p->flags = 0;
+        c->placement = nplacements;
+    }
+    return &placements[c->placement - 1];
+}
+
+static void
+placewindow(Client *c, int x, int y, int w, int h) {
+    Placement *p;
 
-    applyrules(c);
+    if (!deferdepth) {
+        setwindowpos(c, x, y, w, h, 0);
+        return;
+    }
 
+    arrstats.queued++;
+    p = placement(c);
+    p->x = x;
+    p->y = y;
+    p->w = w;
+    p->h = h;
+}
 
-    if (c->isfloating && IsWindowVisible(hwnd)) {
-        resize(c, wi.rcWindow.left, wi.rcWindow.top,
-               wi.rcWindow.right - wi.rcWindow.left,
-               wi.rcWindow.bottom - wi.rcWindow.top);
+static void
+placevisibility(Client *c, bool visibility) {
+    if (!deferdepth) {
+        setvisibility(c->hwnd, visibility);
+        return;
     }
+    placement(c)->flags = visibility ? SWP_SHOWWINDOW : SWP_HIDEWINDOW;
+}
 
-    attach(c);
-    attachstack(c);
-    return c;
+/* Flags for committing p, a window that isn't moved keeps its z-order. */
+static UINT
+placementflags(Placement *p) {
+    if (p->x == p->ox && p->y == p->oy && p->w == p->ow && p->h == p->oh)
+        return p->flags | SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER;
+    return p->flags;
 }
 
 void
-monocle(void) {
-    for (Client *c = nexttiled(clients); c; c = nexttiled(c->next)) {
-        if (c->mon != curmon) continue;
-        int bw = c->bw;
-        resize(c, curmon->wx, curmon->wy, curmon->ww - 2 * bw, curmon->wh - 2 * bw);
+commitplacement(void) {
+    HDWP hdwp;
+    Placement *p;
+    unsigned int i, pass, n = 0;
+
+    if (!deferdepth || --deferdepth)
+        return;
+
+    for (i = 0; i < nplacements; i++) {
+        p = &placements[i];
+        p->c->placement = 0;
+        if (!p->flags && p->x == p->ox && p->y == p->oy && p->w == p->ow && p->h == p->oh)
+            arrstats.dropped++;
+        else
+            placements[n++] = *p;
     }
-}
+    nplacements = 0;
+    if (!n)
+        return;
 
-Client *
-nextchild(Client *p, Client *c) {
-    for (; c && c->parent != p->hwnd; c = c->next);
-    return c;
-}
+    if (n == 1) {
+        p = &placements[0];
+        setwindowpos(p->c, p->x, p->y, p->w, p->h, placementflags(p));
+        return;
+    }
 
-Client *
-nexttiled(Client *c) {
-    for (; c && (c->isfloating || !ISVISIBLE(c)); c = c->next);
-    return c;
-}
+    /* windows coming into view go first and the ones leaving it last, so
+     * the screen never shows an empty gap */
+    hdwp = pf->begindefer(n);
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; hdwp && i < n; i++) {
+            p = &placements[i];
+            if (!!(p->flags & SWP_HIDEWINDOW) == pass)
+                hdwp = pf->defer(hdwp, p->c->hwnd, HWND_TOP, p->x, p->y, p->w, p->h,
+                                      SWP_NOACTIVATE | placementflags(p));
+        }
+    }
+    if (hdwp && pf->enddefer(hdwp)) {
+        arrstats.deferred += n;
+        arrstats.swpcalls++;
+        return;
+    }
 
-void
-quit(const Arg *arg) {
-    PostMessage(dwmhwnd, WM_CLOSE, 0, 0);
+    /* One window refusing to move (e.g. an elevated process) abandons the
+     * whole transaction, retry one by one so that window ends up floating. */
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < n; i++) {
+            p = &placements[i];
+            if (!!(p->flags & SWP_HIDEWINDOW) == pass)
+                setwindowpos(p->c, p->x, p->y, p->w, p->h, placementflags(p));
+        }
+    }
 }
 
 void
@@ -927,13 +3117,16 @@ resize(Client *c, int x, int y, int w, int h) {
     }
 
     Monitor *m = c->mon ? c->mon : selmon;
+    TRACESTART(t);
 
+    if (deferdepth)
+        touchclient(c);
     if (!m) {
         /* fallback to system virtual screen */
-        int sx = GetSystemMetrics(SM_XVIRTUALSCREEN);
-        int sy = GetSystemMetrics(SM_YVIRTUALSCREEN);
-        int sw = GetSystemMetrics(SM_CXVIRTUALSCREEN);
-        int sh = GetSystemMetrics(SM_CYVIRTUALSCREEN);
+        int sx = pf->metric(SM_XVIRTUALSCREEN);
+        int sy = pf->metric(SM_YVIRTUALSCREEN);
+        int sw = pf->metric(SM_CXVIRTUALSCREEN);
+        int sh = pf->metric(SM_CYVIRTUALSCREEN);
 
         if (x > sx + sw) x = sw - WIDTH(c);
         if (y > sy + sh) y = sh - HEIGHT(c);
@@ -950,28 +3143,19 @@ resize(Client *c, int x, int y, int w, int h) {
     }
 
     if (c->x != x || c->y != y || c->w != w || c->h != h) {
+        int px = x;
+        int py = y;
+        int pw = w;
+        int ph = h;
+
+        outerrect(c, &px, &py, &pw, &ph);
+        placewindow(c, px, py, pw, ph);
         c->x = x;
         c->y = y;
         c->w = w;
         c->h = h;
-
-        int px = c->x;
-        int py = c->y;
-        int pw = c->w;
-        int ph = c->h;
-
-        RECT in = {0};
-        if (getframebounds(c->hwnd, &in)) {
-            px -= in.left;
-            py -= in.top;
-            pw += (in.left + in.right);
-            ph += (in.top + in.bottom);
-        }
-
-        /* If the window can't be managed, we assign it as a floating window. */
-        if (!SetWindowPos(c->hwnd, HWND_TOP, c->x, c->y, c->w, c->h, SWP_NOACTIVATE))
-            c->isfloating = true;
     }
+    TRACEEND(t, L"resize", c->hwnd, m);
 }
 
 void
@@ -982,6 +3166,8 @@ restack(void) {
 LRESULT CALLBACK
 barhandler(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     Monitor *m = bar_monitor_from_hwnd(hwnd);
+    PROFSTART(t);
+
     switch (msg) {
     case WM_CREATE:
         updatebars();
@@ -989,10 +3175,15 @@ barhandler(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     case WM_PAINT: {
         PAINTSTRUCT ps;
         BeginPaint(hwnd, &ps);
-        drawbar(m);
+        if (m->bardc && m->barbw == m->ww && m->barbh == m->bh)
+            BitBlt(ps.hdc, 0, 0, m->barbw, m->barbh, m->bardc, 0, 0, SRCCOPY);
+        else
+            drawbar(m);
         EndPaint(hwnd, &ps);
         break;
     }
+    case WM_ERASEBKGND:
+        return 1;
     case WM_LBUTTONDOWN:
     case WM_RBUTTONDOWN:
     case WM_MBUTTONDOWN:
@@ -1001,15 +3192,24 @@ barhandler(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     case WM_TIMER:
         drawbar(m);
         break;
+    case WM_SETTINGCHANGE:
+    case WM_DPICHANGED:
+    case WM_DISPLAYCHANGE:
+        /* the message window gets no broadcasts, the bars do */
+        invalidateframes();
+        return DefWindowProc(hwnd, msg, wParam, lParam);
     default:
         return DefWindowProc(hwnd, msg, wParam, lParam);
     }
 
+    PROFEND(&prof[msg == WM_PAINT ? ProfBarPaint : ProfBar], t);
     return 0;
 }
 
 LRESULT CALLBACK
 WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    PROFSTART(t);
+
     switch (msg) {
     case WM_CREATE:
         break;
@@ -1019,96 +3219,502 @@ WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     case WM_DESTROY:
         PostQuitMessage(0);
         break;
+    case WM_TIMER:
+        if (wParam == EVENTTIMER)
+            processevents();
+        else if (wParam == STATUSTIMER)
+            takestatus();
+        break;
+    case WM_STATUSFEED:
+        takestatus();
+        break;
+    case WM_PIPECOMMAND:
+        runcommands((Command *)lParam);
+        break;
     case WM_HOTKEY:
+        record(RecHotkey, (DWORD)wParam, NULL, false);
         if (wParam > 0 && wParam < LENGTH(keys)) {
             keys[wParam].func(&(keys[wParam].arg));
         }
         break;
     case WM_DISPLAYCHANGE:
     case WM_DEVICECHANGE:
+        record(RecDisplay, msg, NULL, false);
+        invalidateframes();
         updategeom();
         updatebars();
         arrange();
         break;
     default:
         if (msg == shellhookid) { /* Handle the shell hook message */
-            Client *c = getclient((HWND)lParam);
-            switch (wParam & 0x7fff) {
-            case HSHELL_WINDOWCREATED:
-                        if (!c && ismanageable((HWND)lParam)) {
-                            c = manage((HWND)lParam);
-                            managechildwindows(c);
-                            arrange();
-                        }
-                        break;
-                    case HSHELL_WINDOWDESTROYED:
-                        if (c) {
-                            if (!c->ignore)
-                                unmanage(c);
-                            else
-                                c->ignore = false;
-                        }
-                        break;
-                        case HSHELL_WINDOWACTIVATED:
-                            if (c) {
-                                Client *t = sel;
-                                managechildwindows(c);
-
-                                update_client_monitor(c);
-
-                                POINT pt;
-                                GetCursorPos(&pt);
-                                if (monitor_from_point(pt) == c->mon)
-                                    selmon = c->mon;
-
-                                 setselected(c);
-
-                                if (t && (t->isminimized = IsIconic(t->hwnd))) {
-                                arrange();
-                            }
-                            if (sel && sel->isminimized) {
-                                sel->isminimized = false;                                
-                                zoom(NULL);
-                            }
-                        } else  {
-                            if (ismanageable((HWND)lParam)) {
-                                c = manage((HWND)lParam);
-                                managechildwindows(c);
-                                setselected(c);
-                                arrange();
-                            }
-                        }
-                        break;
-                }
-            } else
-                return DefWindowProc(hwnd, msg, wParam, lParam); 
+            record(RecShell, (DWORD)(wParam & 0x7fff), (HWND)lParam, !getclient((HWND)lParam));
+            /* windows come and go through the WinEvent hooks */
+            if ((wParam & 0x7fff) == HSHELL_WINDOWACTIVATED)
+                queueevent((HWND)lParam, EvActivated);
+        } else
+            return DefWindowProc(hwnd, msg, wParam, lParam);
     }
 
+    PROFEND(profhist(msg, wParam), t);
     return 0;
 }
 
+/* Appends an event to the -r log. A snapshot is taken when a window may be
+ * new to us or has been renamed, the rest of the log refers to it by HWND. */
+void
+record(DWORD kind, DWORD code, HWND hwnd, bool snapshot) {
+    Record r = { 0 };
+    RecWindow w = { 0 };
+    WINDOWINFO wi = { .cbSize = sizeof(WINDOWINFO) };
+    LARGE_INTEGER t;
+
+    if (!recfile)
+        return;
+    QueryPerformanceCounter(&t);
+    r.t = t.QuadPart;
+    r.hwnd = (ULONGLONG)(ULONG_PTR)hwnd;
+    r.kind = kind;
+    r.code = code;
+    if (snapshot && hwnd && pf->windowinfo(hwnd, &wi)) {
+        r.snapshot = 1;
+        pf->windowthread(hwnd, &w.pid);
+        w.style = wi.dwStyle;
+        w.exstyle = wi.dwExStyle;
+        w.rect = wi.rcWindow;
+        pf->classname(hwnd, w.classname, (int)LENGTH(w.classname));
+        pf->title(hwnd, w.title, (int)LENGTH(w.title));
+    }
+    if (fwrite(&r, sizeof(r), 1, recfile) != 1
+    || (r.snapshot && fwrite(&w, sizeof(w), 1, recfile) != 1)) {
+        debug(L"record: write failed, recording stopped\n");
+        fclose(recfile);
+        recfile = NULL;
+    }
+}
+
+void
+startrecording(const wchar_t *path) {
+    RecHeader h = { RECMAGIC, RECVERSION };
+    LARGE_INTEGER freq;
+
+    if (!(recfile = _wfopen(path, L"wb")))
+        die(L"could not open %ls for recording\n", path);
+    /* storms come in bursts, let stdio gather them */
+    setvbuf(recfile, NULL, _IOFBF, 64 * 1024);
+    QueryPerformanceFrequency(&freq);
+    h.freq = freq.QuadPart;
+    if (fwrite(&h, sizeof(h), 1, recfile) != 1)
+        die(L"could not write to %ls\n", path);
+}
+
+LONGLONG
+profnow(void) {
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+#ifdef PROFILE
+unsigned int
+histbucket(ULONGLONG v) {
+    unsigned int e = 0;
+
+    if (v < HISTSUB)
+        return (unsigned int)v;
+    for (; v >= 2 * HISTSUB; v >>= 1)
+        e++;
+    return (e + 1) * HISTSUB + (unsigned int)(v - HISTSUB);
+}
+
+/* largest value that falls into bucket b */
+ULONGLONG
+histbound(unsigned int b) {
+    if (b < HISTSUB)
+        return b;
+    return ((ULONGLONG)(HISTSUB + b % HISTSUB + 1) << (b / HISTSUB - 1)) - 1;
+}
+
+void
+histadd(Hist *h, LONGLONG ticks) {
+    ULONGLONG v = ticks < 0 ? 0 : (ULONGLONG)ticks;
+
+    h->bucket[histbucket(v)]++;
+    h->count++;
+    h->total += v;
+    if (v > h->max)
+        h->max = v;
+}
+
+/* the p-th fraction of the samples are at or below the result */
+ULONGLONG
+histpercentile(const Hist *h, double p) {
+    unsigned int b, seen = 0, want = (unsigned int)(p * h->count + 0.999);
+
+    for (b = 0; b < HISTBUCKETS; b++)
+        if ((seen += h->bucket[b]) >= want)
+            return MIN(histbound(b), h->max);
+    return h->max;
+}
+
+Hist *
+profhist(UINT msg, WPARAM wParam) {
+    if (msg == WM_HOTKEY && wParam < LENGTH(keys))
+        return &keyprof[wParam];
+    if (msg == WM_CLOSE)
+        return &prof[ProfClose];
+    if (msg == WM_STATUSFEED || (msg == WM_TIMER && wParam == STATUSTIMER))
+        return &prof[ProfStatus];
+    if (msg == WM_TIMER)
+        return &prof[ProfEventTimer];
+    if (msg == WM_DISPLAYCHANGE || msg == WM_DEVICECHANGE)
+        return &prof[ProfDisplay];
+    if (msg == WM_PIPECOMMAND)
+        return &prof[ProfCommand];
+    if (msg == shellhookid)
+        return &prof[ProfShell];
+    return &prof[ProfOther];
+}
+
+int
+profline(wchar_t *buf, size_t len, const wchar_t *name, unsigned int key, const Hist *h, double us) {
+    if (!h->count)
+        return 0;
+    return swprintf(buf, len, L"%-18ls%3u %8u calls  p50 %9.1f  p99 %9.1f  max %9.1f  avg %9.1f us\n",
+        name, key, h->count, histpercentile(h, 0.5) * us, histpercentile(h, 0.99) * us,
+        h->max * us, (double)h->total / h->count * us);
+}
+
+/* fills buf with one line per handler that ran, times in microseconds */
+void
+profreport(wchar_t *buf, size_t len) {
+    LARGE_INTEGER freq;
+    size_t n = 0;
+    unsigned int i;
+    int r;
+    double us;
+
+    QueryPerformanceFrequency(&freq);
+    us = 1e6 / (double)freq.QuadPart;
+    buf[0] = L'\0';
+    for (i = 0; i < ProfLast && n < len; i++)
+        if ((r = profline(buf + n, len - n, profnames[i], 0, &prof[i], us)) > 0)
+            n += r;
+    for (i = 0; i < LENGTH(keys) && n < len; i++)
+        if ((r = profline(buf + n, len - n, L"key", i, &keyprof[i], us)) > 0)
+            n += r;
+}
+#endif
+
+void
+showprofile(const Arg *arg) {
+#ifdef PROFILE
+    static wchar_t buf[8192];
+
+    profreport(buf, LENGTH(buf));
+    MessageBoxW(NULL, buf[0] ? buf : L"nothing measured yet", L"handler latency", MB_OK | MB_ICONINFORMATION);
+#else
+    MessageBoxW(NULL, L"built without PROFILE", L"handler latency", MB_OK | MB_ICONINFORMATION);
+#endif
+}
+
+/* Writes the report of showprofile() to the file arg->v. */
+void
+dumpprofile(const Arg *arg) {
+#ifdef PROFILE
+    static wchar_t buf[8192];
+    FILE *f;
+
+    profreport(buf, LENGTH(buf));
+    if (!(f = _wfopen((const wchar_t *)arg->v, L"w"))) {
+        debug(L"dumpprofile: could not open %ls\n", (const wchar_t *)arg->v);
+        return;
+    }
+    fprintf(f, "%ls", buf);
+    fclose(f);
+#endif
+}
+
+/* Ends a span begun with TRACESTART. Only called while tracing. */
+void
+traceend(LONGLONG start, const wchar_t *name, HWND hwnd, Monitor *m) {
+    Span *sp = &spans[nspans++ & (TRACESPANS - 1)];
+
+    sp->end = profnow();
+    sp->start = start;
+    sp->name = name;
+    sp->hwnd = hwnd;
+    sp->mon = m;
+}
+
+/* Starts recording spans, or stops and writes them to arg->v as Chrome
+ * trace events, for Perfetto or about:tracing. */
+void
+toggletrace(const Arg *arg) {
+    if (tracing) {
+        tracing = false;
+        writetrace((const wchar_t *)arg->v);
+        return;
+    }
+    if (!spans && !(spans = calloc(TRACESPANS, sizeof(Span))))
+        die(L"fatal: could not allocate %u bytes for spans\n", (unsigned)(TRACESPANS * sizeof(Span)));
+    nspans = 0;
+    tracing = true;
+}
+
+void
+jsonstr(FILE *f, const wchar_t *s) {
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == L'"' || *s == L'\\')
+            fprintf(f, "\\%c", (char)*s);
+        else if (*s < 0x20 || *s > 0x7e)
+            fprintf(f, "\\u%04x", (unsigned int)*s);
+        else
+            fputc((char)*s, f);
+    }
+    fputc('"', f);
+}
+
+/* Looks up what traceend() left out, as things are now: a window may have
+ * gone or a monitor been replaced since the span ended. */
+static void
+spanargs(const Span *sp, wchar_t *classname, int len, int *mon) {
+    Client *c = sp->hwnd ? getclient(sp->hwnd) : NULL;
+    Monitor *m = sp->mon, *t;
+
+    classname[0] = L'\0';
+    if (c) {
+        wcsncpy(classname, c->classname, len - 1);
+        classname[len - 1] = L'\0';
+    } else if (sp->hwnd && !pf->classname(sp->hwnd, classname, len))
+        classname[0] = L'\0';
+    if (!m && c)
+        m = c->mon;
+    for (*mon = 0, t = mons; t && t != m; t = t->next, (*mon)++);
+    if (!t)
+        *mon = -1;
+}
+
+void
+writetrace(const wchar_t *path) {
+    LARGE_INTEGER freq;
+    unsigned int i = nspans > TRACESPANS ? nspans - TRACESPANS : 0;
+    LONGLONG base;
+    double us;
+    Span *sp;
+    FILE *f;
+    wchar_t classname[256];
+    int mon;
+
+    if (!nspans)
+        return;
+    if (!(f = _wfopen(path, L"wb"))) {
+        debug(L"writetrace: could not open %ls\n", path);
+        return;
+    }
+    QueryPerformanceFrequency(&freq);
+    us = 1e6 / (double)freq.QuadPart;
+    base = spans[i & (TRACESPANS - 1)].start;
+    fprintf(f, "{\"traceEvents\":[\n");
+    for (; i < nspans; i++) {
+        sp = &spans[i & (TRACESPANS - 1)];
+        /* spans are stored as they end, the first may have begun earlier */
+        if (sp->start < base)
+            base = sp->start;
+    }
+    for (i = nspans > TRACESPANS ? nspans - TRACESPANS : 0; i < nspans; i++) {
+        sp = &spans[i & (TRACESPANS - 1)];
+        spanargs(sp, classname, (int)LENGTH(classname), &mon);
+        fprintf(f, "{\"name\":");
+        jsonstr(f, sp->name);
+        fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+                "\"args\":{\"hwnd\":\"%p\",\"monitor\":%d,\"class\":",
+                (sp->start - base) * us, (sp->end - sp->start) * us, (void *)sp->hwnd, mon);
+        jsonstr(f, classname);
+        fprintf(f, "}}%s\n", i + 1 < nspans ? "," : "");
+    }
+    fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(f);
+}
+
+void
+queueevent(HWND hwnd, unsigned int what) {
+    unsigned int i;
+
+    events.received++;
+    if (what & EvActivated)
+        events.activated = hwnd;
+    /* bursts are short, a backwards scan finds repeats soonest */
+    for (i = events.n; i > 0 && events.ev[i - 1].hwnd != hwnd; i--);
+    if (i > 0) {
+        /* of opposite events only the last one counts */
+        if (what & (EvCloaked | EvUncloaked))
+            events.ev[i - 1].what &= ~(EvCloaked | EvUncloaked);
+        if (what & (EvMinimized | EvRestored))
+            events.ev[i - 1].what &= ~(EvMinimized | EvRestored);
+        events.ev[i - 1].what |= what;
+    } else {
+        if (events.n == events.cap) {
+            unsigned int cap = events.cap ? events.cap * 2 : 32;
+            Event *t = realloc(events.ev, cap * sizeof(Event));
+            if (!t)
+                die(L"fatal: could not realloc() %u bytes\n", cap * (unsigned)sizeof(Event));
+            events.ev = t;
+            events.cap = cap;
+        }
+        events.ev[events.n].hwnd = hwnd;
+        events.ev[events.n++].what = what;
+    }
+    if (eventdelay)
+        SetTimer(dwmhwnd, EVENTTIMER, eventdelay, NULL);    /* restarts the quiet period */
+}
+
+static void
+activate(HWND hwnd) {
+    Client *c = getclient(hwnd);
+    POINT pt;
+
+    if (!c) {
+        if (ismanageable(hwnd) && (c = manage(hwnd)))
+            setselected(c);
+        return;
+    }
+    pf->cursorpos(&pt);
+    if (monitor_from_point(pt) == c->mon)
+        selmon = c->mon;
+    setselected(c);
+}
+
+/* Handle the queued events with flush() held, so a burst of new windows
+ * is laid out and painted once. */
+void
+processevents(void) {
+    Event *ev = events.ev;
+    unsigned int i, what, n = events.n, cap = events.cap;
+    HWND active = events.activated;
+    Client *c;
+
+    if (eventdelay)
+        KillTimer(dwmhwnd, EVENTTIMER);
+    if (!n && !active)
+        return;
+    /* handlers may pump messages and queue more, give them a new array */
+    events.ev = NULL;
+    events.n = events.cap = 0;
+    events.activated = NULL;
+    events.batches++;
+
+    holdflush++;
+    for (i = 0; i < n; i++) {
+        c = getclient(ev[i].hwnd);
+        what = ev[i].what;
+        /* a hide and a show may have been merged, the window knows the outcome */
+        if (c && ((what & EvDestroyed)
+        || ((what & EvHidden) && !c->hidden && !pf->visible(c->hwnd)))) {
+            unmanage(c);
+            c = NULL;
+        }
+        if (c) {
+            if (what & (EvCloaked | EvUncloaked))
+                c->iscloaked = what & EvCloaked;
+            if (what & EvName) {
+                updatetitle(c);
+                if (c == sel) {
+                    dirtybar(c->mon, SegTitle);
+                    dirtymon(c->mon, DirtyBar);
+                }
+            }
+            if (what & EvMinimized) {
+                /* its tile goes to the others, the selection moves on */
+                c->isminimized = true;
+                dirtymon(c->mon, DirtyLayout | DirtyBar);
+                if (c == sel)
+                    focus(NULL);
+            }
+            if (what & EvRestored) {
+                /* a restored window comes back as the master */
+                c->isminimized = false;
+                if (!c->isfloating) {
+                    detach(c);
+                    attach(c);
+                    dirtymon(c->mon, DirtyLayout | DirtyBar);
+                }
+            }
+            if (what & (EvMoved | EvRestored))
+                checkframe(c);
+            if (what & EvMoved)
+                update_client_monitor(c);
+        } else if ((what & (EvCreated | EvUncloaked)) && !(what & EvDestroyed)
+               && ismanageable(ev[i].hwnd)) {
+            if ((c = manage(ev[i].hwnd)) && (what & EvUncloaked))
+                setselected(c);
+        }
+    }
+    if (active)
+        activate(active);
+    holdflush--;
+
+    if (events.ev) {
+        free(ev);
+    } else {
+        events.ev = ev;
+        events.cap = cap;
+    }
+    flush();
+}
+
 void
 CALLBACK
 wineventproc(HWINEVENTHOOK heventhook, DWORD event, HWND hwnd, LONG object, LONG child, DWORD eventthread, DWORD eventtime_ms) {
-    if (object != OBJID_WINDOW || child != CHILDID_SELF || event != EVENT_OBJECT_UNCLOAKED || hwnd == NULL)
+    PROFSTART(t);
+
+    /* the filtered events are timed too, most of a storm is dropped here */
+    if (object != OBJID_WINDOW || child != CHILDID_SELF || hwnd == NULL) {
+        PROFEND(&prof[ProfWinEvent], t);
         return;
+    }
 
     Client *c = getclient(hwnd);
 
-    if (!c && ismanageable(hwnd)) {
-        c = manage(hwnd);
-        managechildwindows(c);
-        setselected(c);
-        arrange();
+    record(RecWinEvent, event, hwnd, event == EVENT_OBJECT_CREATE || event == EVENT_OBJECT_SHOW
+           || event == EVENT_OBJECT_NAMECHANGE || event == EVENT_OBJECT_UNCLOAKED);
+
+    switch (event) {
+    case EVENT_OBJECT_CREATE:
+    case EVENT_OBJECT_SHOW:
+        if (c)
+            break;
+        /* controls come by the thousand, ismanageable() only takes a
+         * child window that is an app or tool window */
+        if ((pf->style(hwnd, GWL_STYLE) & WS_CHILD)
+        && !(pf->style(hwnd, GWL_EXSTYLE) & (WS_EX_APPWINDOW | WS_EX_TOOLWINDOW)))
+            break;
+        queueevent(hwnd, EvCreated);
+        break;
+    case EVENT_OBJECT_UNCLOAKED:
+        queueevent(hwnd, EvUncloaked);
+        break;
+    default:
+        /* the rest is only of interest for clients */
+        if (!c)
+            break;
+        switch (event) {
+        case EVENT_OBJECT_DESTROY:          queueevent(hwnd, EvDestroyed); break;
+        case EVENT_OBJECT_HIDE:             queueevent(hwnd, EvHidden); break;
+        case EVENT_OBJECT_NAMECHANGE:       queueevent(hwnd, EvName); break;
+        case EVENT_OBJECT_CLOAKED:          queueevent(hwnd, EvCloaked); break;
+        case EVENT_SYSTEM_MINIMIZESTART:    queueevent(hwnd, EvMinimized); break;
+        case EVENT_SYSTEM_MINIMIZEEND:      queueevent(hwnd, EvRestored); break;
+        case EVENT_OBJECT_LOCATIONCHANGE:   queueevent(hwnd, EvMoved); break;
+        }
+        break;
     }
+    PROFEND(&prof[ProfWinEvent], t);
 }
 
 BOOL CALLBACK
 scan(HWND hwnd, LPARAM lParam) {
-    Client *c = getclient(hwnd);
-    if (c)
-        c->isalive = true;
-    else if (ismanageable(hwnd))
+    if (!getclient(hwnd) && ismanageable(hwnd))
         manage(hwnd);
 
     return TRUE;
@@ -1117,8 +3723,8 @@ scan(HWND hwnd, LPARAM lParam) {
 /* Only works on Windows 11 and later */
 void
 drawborder(Client *c, COLORREF color) {
-    if (!c || !IsWindow(c->hwnd)) return;
-    DwmSetWindowAttribute(
+    if (!c || !pf->iswindow(c->hwnd)) return;
+    pf->setattribute(
         c->hwnd,
         34,
         &color,
@@ -1130,8 +3736,8 @@ drawborder(Client *c, COLORREF color) {
 void
 nocorners(Client* c) {
     int sharpen = 1;
-    if (!c || !IsWindow(c->hwnd)) return;
-    DwmSetWindowAttribute(
+    if (!c || !pf->iswindow(c->hwnd)) return;
+    pf->setattribute(
         c->hwnd,
         33,
         &sharpen,
@@ -1141,7 +3747,7 @@ nocorners(Client* c) {
 
 void
 setvisibility(HWND hwnd, bool visibility) {
-    SetWindowPos(hwnd, 0, 0, 0, 0, 0, (visibility ? SWP_SHOWWINDOW : SWP_HIDEWINDOW) | SWP_NOACTIVATE | SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER);
+    pf->setwindowpos(hwnd, 0, 0, 0, 0, 0, (visibility ? SWP_SHOWWINDOW : SWP_HIDEWINDOW) | SWP_NOACTIVATE | SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER);
 }
 
 void
@@ -1151,10 +3757,8 @@ setlayout(const Arg *arg) {
         selmon->sellt ^= 1;
     if (arg && arg->v)
         selmon->lt[selmon->sellt] = (Layout *)arg->v;
-    if (sel)
-        arrange();
-    else
-        updatebars();
+    dirtymon(selmon, DirtyLayout | DirtyBar);
+    flush();
 }
 
 void
@@ -1166,7 +3770,8 @@ setmfact(const Arg *arg) {
     if (f < 0.1 || f > 0.9)
         return;
     selmon->mfact = f;
-    arrange();
+    dirtymon(selmon, DirtyLayout);
+    flush();
 }
 
 void
@@ -1174,6 +3779,9 @@ setup(HINSTANCE hInstance) {
     WNDCLASSEXW wc;
     HWND hwnd;
 
+    compilerules();
+    startworkers();
+
     /* initialize global fallback layouts */
     lt[0] = &layouts[0];
     lt[1] = &layouts[1 % LENGTH(layouts)];
@@ -1189,17 +3797,20 @@ setup(HINSTANCE hInstance) {
     dc.pen = CreatePen(PS_SOLID, borderpx, selbordercolor);
     dc.brush[0] = CreateSolidBrush(dc.norm[ColBG]);
     dc.brush[1] = CreateSolidBrush(dc.sel[ColBG]);
+    dc.fgbrush[0] = CreateSolidBrush(dc.norm[ColFG]);
+    dc.fgbrush[1] = CreateSolidBrush(dc.sel[ColFG]);
 
     /* save colors so we can restore them in cleanup */
     for (unsigned int i = 0; i < LENGTH(colorwinelements); i++)
         colors[0][i] = GetSysColor(colorwinelements[i]);
+    colorssaved = true;
 
     SetSysColors(LENGTH(colorwinelements), colorwinelements, colors[1]);
 
     SystemParametersInfoW(SPI_SETACTIVEWINDOWTRACKING, 0, (void *)(INT_PTR)!focusonclick, 0);
     SystemParametersInfoW(SPI_SETACTIVEWNDTRKTIMEOUT, 0, (void *)(INT_PTR)0, 0);
 
-    hwnd = FindWindowW(L"Shell_TrayWnd", NULL);
+    hwnd = pf->findwindow(L"Shell_TrayWnd", NULL);
     if (hwnd)
         setvisibility(hwnd, showexploreronstart);
 
@@ -1233,6 +3844,8 @@ setup(HINSTANCE hInstance) {
     SelectObject(dc.hdc, font);
     for (unsigned int i = 0; i < LENGTH(tags); i++)
         tagw[i] = TEXTW(tags[i]);
+    wcsncpy(stext, NAME, LENGTH(stext) - 1);
+    stextversion++;
     ReleaseDC(dwmhwnd, dc.hdc);
 
     /* build monitors and bars */
@@ -1242,7 +3855,7 @@ setup(HINSTANCE hInstance) {
     }
 
     /* initial scan of windows */
-    EnumWindows(scan, 0);
+    pf->enumwindows(scan, 0);
 
     if (!selmon) selmon = mons;
 
@@ -1250,14 +3863,19 @@ setup(HINSTANCE hInstance) {
 
     arrange();
     
-    if (!RegisterShellHookWindow(dwmhwnd))
+    if (!pf->shellhook(dwmhwnd, true))
         die(L"Could not RegisterShellHookWindow");
 
     shellhookid = RegisterWindowMessageW(L"SHELLHOOK");
 
-    wineventhook = SetWinEventHook(EVENT_OBJECT_UNCLOAKED, EVENT_OBJECT_UNCLOAKED, NULL, wineventproc, 0, 0, WINEVENT_OUTOFCONTEXT);
-    if (!wineventhook)
-        die(L"Could not SetWinEventHook");
+    for (unsigned int i = 0; i < LENGTH(winevents); i++) {
+        wineventhooks[i] = pf->hookevents(winevents[i][0], winevents[i][1], wineventproc);
+        if (!wineventhooks[i])
+            die(L"Could not SetWinEventHook");
+    }
+
+    startcmdserver();
+    startstatusfeed();
 
     updatebars();
 
@@ -1327,31 +3945,51 @@ showclientinfo(const Arg *arg) {
 
     if (!sel) return;
     swprintf(buffer, LENGTH(buffer),
-        L"Title: %s\nClass: %s\nProcess: %s\n\nFloating: %s\nTags: %u",
-        getclienttitle(sel->hwnd),
-        getclientclassname(sel->hwnd),
+        L"Title: %s\nClass: %s\nProcess: %s\n\nFloating: %s\nTags: %u\n\n"
+        L"Bar repaints: tags %lu, layout %lu, status %lu, title %lu\n"
+        L"Processes: %u tracked, %u images interned, %u of %u arena bytes used\n"
+        L"Clients: %u live, %u peak, %u slabs\nMonitors: %u live, %u peak, %u slabs\n"
+        L"Last flush: %u monitors, %u clients, %u SetWindowPos\n"
+        L"Events: %u received, %u batches, %u arranges",
+        sel->title,
+        sel->classname,
         sel->processname,
         sel->isfloating ? L"Yes" : L"No",
-        sel->tags);
+        sel->tags,
+        barrepaints[SegTags], barrepaints[SegLayout],
+        barrepaints[SegStatus], barrepaints[SegTitle],
+        nprocs, nimages, (unsigned)arenaused, (unsigned)arenabytes,
+        clientpool.live, clientpool.highwater, clientpool.nslabs,
+        monitorpool.live, monitorpool.highwater, monitorpool.nslabs,
+        arrstats.monitors, arrstats.clients, arrstats.swpcalls,
+        events.received, events.batches, arranges);
     MessageBoxW(NULL, buffer, L"client info", MB_OK | MB_ICONINFORMATION);
 }
 
 void
 showhide(Client *c) {
-    if (!c)
-        return;
+    Monitor *m = c ? c->mon : NULL;
+    TRACESTART(t);
+
+    for (; c; c = c->snext)
+        updatevisibility(c);
+    TRACEEND(t, L"showhide", NULL, m);
+}
+
+void
+updatevisibility(Client *c) {
     if (!ISVISIBLE(c)) {
-        if (IsWindowVisible(c->hwnd)) {
-            c->ignore = true;
+        if (pf->visible(c->hwnd)) {
+            c->hidden = true;
             c->wasvisible = true;
-            setvisibility(c->hwnd, false);
+            placevisibility(c, false);
         }
     } else {
-        if (c->wasvisible) {
-            setvisibility(c->hwnd, true);
+        if (c->hidden) {
+            c->hidden = false;
+            placevisibility(c, true);
         }
     }
-    showhide(c->snext);
 }
 
 void
@@ -1365,59 +4003,61 @@ tag(const Arg *arg) {
 
     if (sel && arg->ui & TAGMASK) {
         sel->tags = arg->ui & TAGMASK;
-        for (c = managechildwindows(sel); c; c = nextchild(sel, c->next)) {
-            if (c->isfloating)
-                c->tags = arg->ui & TAGMASK;
+        dirtyclient(sel);
+        dirtymon(sel->mon, DirtyLayout | DirtyBar);
+        for (Monitor *m = mons; m; m = m->next) {
+            for (c = m->clients; c; c = c->next) {
+                if (c->parent == sel->hwnd && c->isfloating) {
+                    c->tags = arg->ui & TAGMASK;
+                    dirtyclient(c);
+                    dirtymon(m, DirtyBar);
+                }
+            }
         }
-        arrange();
+        flush();
     }
 }
 
-int
-textnw(const wchar_t *text, unsigned int len) {
-    SIZE size;
-    GetTextExtentPoint32W(dc.hdc, text, len, &size);
-    if (size.cx > 0)
-        size.cx += textmargin;
-    return size.cx;  
-}
-
+/* Let go of every client at exit: show what we hid in one batch and drop
+ * the lists, without the relayout and refocus unmanage() does per window.
+ * The client records go with their pool. */
 void
-tile(void) {
-    unsigned int i, n = 0;
-    Client *c, *m = NULL;
+teardown(void) {
+    Process *p;
+    Client *c;
+    unsigned int i;
 
-    for (c = clients; c; c = c->next) {
-        if (c->mon != curmon) continue;
-        if (!c->isfloating && ISVISIBLE(c)) {
-            if (!m) m = c;
-            n++;
+    beginplacement();
+    for (Monitor *m = mons; m; m = m->next) {
+        for (c = m->stack; c; c = c->snext)
+            if (c->hidden)
+                placevisibility(c, true);
+    }
+    commitplacement();
+
+    for (Monitor *m = mons; m; m = m->next)
+        m->clients = m->stack = NULL;
+    sel = NULL;
+    ndirtyclients = 0;
+    for (i = 0; i < LENGTH(procs); i++) {
+        while ((p = procs[i])) {
+            procs[i] = p->next;
+            p->next = freeprocs;
+            freeprocs = p;
         }
     }
-    if (n == 0 || !m)
-        return;
-
-    /* master */
-    int mw = (n == 1) ? curmon->ww : (int)(curmon->mfact * curmon->ww);
-    resize(m, curmon->wx, curmon->wy, mw - 2 * m->bw, curmon->wh - 2 * m->bw);
-
-    if (--n == 0)
-        return;
+    nprocs = 0;
+}
 
-    /* tile stack */
-    int x = curmon->wx + mw;
-    int y = curmon->wy;
-    int w = curmon->ww - mw;
-    int h = curmon->wh / n;
+int
+textnw(const wchar_t *text, unsigned int len) {
+    SIZE size = { 0 };
 
-    for (i = 0, c = nexttiled(m->next); c; c = nexttiled(c->next)) {
-        if (c->mon != curmon || c->isfloating) continue;
-        resize(c, x, y, w - 2 * c->bw, ((i + 1 == n)
-               ? curmon->wy + curmon->wh - y - 2 * c->bw : h - 2 * c->bw));
-        if (h != curmon->wh)
-            y = c->y + HEIGHT(c);
-        i++;
-    }
+    if (!GetTextExtentPoint32W(dc.hdc, text, len, &size))
+        return 0;
+    if (size.cx > 0)
+        size.cx += textmargin;
+    return size.cx;  
 }
 
 void
@@ -1430,13 +4070,13 @@ togglebar(const Arg *arg) {
 
 void
 toggleexplorer(const Arg *arg) {
-    HWND hwnd = FindWindowW(L"Progman", L"Program Manager");
+    HWND hwnd = pf->findwindow(L"Progman", L"Program Manager");
     if (hwnd)
-        setvisibility(hwnd, !IsWindowVisible(hwnd));
+        setvisibility(hwnd, !pf->visible(hwnd));
 
-    hwnd = FindWindowW(L"Shell_TrayWnd", NULL);
+    hwnd = pf->findwindow(L"Shell_TrayWnd", NULL);
     if (hwnd)
-        setvisibility(hwnd, !IsWindowVisible(hwnd));
+        setvisibility(hwnd, !pf->visible(hwnd));
 
     updategeom();
     updatebars();
@@ -1450,7 +4090,8 @@ togglefloating(const Arg *arg) {
     sel->isfloating = !sel->isfloating || sel->isfixed;
     if (sel->isfloating)
         resize(sel, sel->x, sel->y, sel->w, sel->h);
-    arrange();
+    dirtymon(sel->mon, DirtyLayout | DirtyBar);
+    flush();
 }
 
 void
@@ -1470,7 +4111,9 @@ toggletag(const Arg *arg) {
     mask = sel->tags ^ (arg->ui & TAGMASK);
     if (mask) {
         sel->tags = mask;
-        arrange();
+        dirtyclient(sel);
+        dirtymon(sel->mon, DirtyLayout | DirtyBar);
+        flush();
     }
 }
 
@@ -1481,7 +4124,8 @@ toggleview(const Arg *arg) {
 
     if (mask) {
         selmon->tagset[selmon->seltags] = mask;
-        arrange();
+        dirtymon(selmon, DirtyAll);
+        flush();
     }
 }
 
@@ -1489,16 +4133,22 @@ void
 unmanage(Client *c) {
     if (c->wasvisible)
         setvisibility(c->hwnd, true);
+    if (c->dirty) {
+        for (unsigned int i = 0; i < ndirtyclients; i++)
+            if (dirtyclients[i] == c) {
+                dirtyclients[i] = dirtyclients[--ndirtyclients];
+                break;
+            }
+    }
+    dirtymon(c->mon, DirtyLayout | DirtyBar);
     detach(c);
     detachstack(c);
+    hashremove(c);
     if (sel == c)
         focus(NULL);
-    /* free processname buffer if dynamically assigned */
-    if (c->processname && wcslen(c->processname) > 0) {
-        free((void*)c->processname);
-    }
-    free(c);
-    arrange();
+    releaseprocess(c->proc);
+    poolfree(&clientpool, c);
+    flush();
 }
 
 void
@@ -1526,43 +4176,28 @@ updategeom(void) {
 /* Monitor enumeration callback */
 BOOL CALLBACK
 monenumproc(HMONITOR hMon, HDC hdc, LPRECT lprc, LPARAM lParam) {
-    (void)hdc; (void)lprc; (void)lParam;
+    (void)hdc; (void)lprc;
+    Monitor **old = (Monitor **)lParam, **pm, *m, *tail;
     MONITORINFOEXW mi;
     memset(&mi, 0, sizeof(mi));
     mi.cbSize = sizeof(mi);
-    if (!GetMonitorInfoW(hMon, (MONITORINFO*)&mi))
+    if (!pf->monitorinfo(hMon, &mi))
         return TRUE;
 
-    Monitor *prev = NULL;
-    for (Monitor *m = mons; m; prev = m, m = m->next) {
-        if (m->hmon == hMon) {
-            /* update existing geometry */
-            m->mi = mi;
-            /* prefer work area if explorer taskbar is visible */
-            HWND task = FindWindowW(L"Shell_TrayWnd", NULL);
-            BOOL useWork = (task && IsWindowVisible(task));
-            RECT r = useWork ? mi.rcWork : mi.rcMonitor;
-            m->sx = r.left;
-            m->sy = r.top;
-            m->sw = r.right - r.left;
-            m->sh = r.bottom - r.top;
-            m->bh = 20; /* fixed bar height */
-            m->wx = m->sx;
-            m->wy = showbar && topbar ? m->sy + m->bh : m->sy;
-            m->ww = m->sw;
-            m->wh = showbar ? m->sh - m->bh : m->sh;
-            m->by = showbar ? (topbar ? m->wy - m->bh : m->wy + m->wh) : -m->bh;
+    /* reuse the record of a known monitor, it keeps its clients and bar */
+    for (pm = old; *pm && (*pm)->hmon != hMon; pm = &(*pm)->next);
+    if ((m = *pm)) {
+        *pm = m->next;
+    } else {
+        if (!(m = poolalloc(&monitorpool)))
             return TRUE;
-        }
+        m->hmon = hMon;
     }
-
-    Monitor *m = (Monitor*)calloc(1, sizeof(Monitor));
-    if (!m) return TRUE;
-    m->hmon = hMon;
     m->mi = mi;
 
-    HWND task = FindWindowW(L"Shell_TrayWnd", NULL);
-    BOOL useWork = (task && IsWindowVisible(task));
+    /* prefer work area if explorer taskbar is visible */
+    HWND task = pf->findwindow(L"Shell_TrayWnd", NULL);
+    BOOL useWork = (task && pf->visible(task));
     RECT r = useWork ? mi.rcWork : mi.rcMonitor;
 
     m->sx = r.left;
@@ -1581,10 +4216,11 @@ monenumproc(HMONITOR hMon, HDC hdc, LPRECT lprc, LPARAM lParam) {
 
     m->next = NULL;
 
-    if (!mons) {
+    for (tail = mons; tail && tail->next; tail = tail->next);
+    if (!tail) {
         mons = m;
     } else {
-        prev->next = m;
+        tail->next = m;
     }
 
     return TRUE;
@@ -1592,20 +4228,46 @@ monenumproc(HMONITOR hMon, HDC hdc, LPRECT lprc, LPARAM lParam) {
 
 void
 buildmonitors(void) {
-    Monitor *old = mons;
+    Monitor *old = mons, *p;
+    Client *c, *t;
     mons = NULL;
 
-    EnumDisplayMonitors(NULL, NULL, monenumproc, 0);
+    pf->enummonitors(monenumproc, (LPARAM)&old);
+
+    if (!mons) {
+        /* keep what we had rather than losing track of every client */
+        mons = old;
+        return;
+    }
 
-    for (Monitor *p = old; p; ) {
-        Monitor *next = p->next;
-        bool still_present = false;
-        for (Monitor *m = mons; m; m = m->next) if (m->hmon == p->hmon) { still_present = true; break; }
-        if (!still_present) {
-            if (p->barhwnd) DestroyWindow(p->barhwnd);
-            free(p);
+    /* monitors left in old were disconnected, their clients move to the first one */
+    while ((p = old)) {
+        old = p->next;
+        for (c = p->clients; c; c = c->next)
+            c->mon = mons;
+        if (p->clients) {
+            for (t = mons->clients; t && t->next; t = t->next);
+            if (t)
+                t->next = p->clients;
+            else
+                mons->clients = p->clients;
+            p->clients->prev = t;
         }
-        p = next;
+        if (p->stack) {
+            for (t = mons->stack; t && t->snext; t = t->snext);
+            if (t)
+                t->snext = p->stack;
+            else
+                mons->stack = p->stack;
+            p->stack->sprev = t;
+        }
+        if (selmon == p)
+            selmon = mons;
+        if (curmon == p)
+            curmon = mons;
+        freebuffer(p);
+        if (p->barhwnd) DestroyWindow(p->barhwnd);
+        poolfree(&monitorpool, p);
     }
 
     if (!selmon) selmon = mons;
@@ -1613,14 +4275,14 @@ buildmonitors(void) {
 
 static Monitor *
 monitor_from_hwnd(HWND hwnd) {
-    HMONITOR hMon = MonitorFromWindow(hwnd, MONITOR_DEFAULTTONEAREST);
+    HMONITOR hMon = pf->windowmonitor(hwnd);
     for (Monitor *m = mons; m; m = m->next) if (m->hmon == hMon) return m;
     return mons;
 }
 
 static Monitor *
 monitor_from_point(POINT pt) {
-    HMONITOR hMon = MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST);
+    HMONITOR hMon = pf->pointmonitor(pt);
     for (Monitor *m = mons; m; m = m->next) if (m->hmon == hMon) return m;
     return mons;
 }
@@ -1633,66 +4295,49 @@ view(const Arg *arg) {
     selmon->seltags ^= 1; /* toggle sel tagset for this monitor */
     if (arg->ui & TAGMASK)
         selmon->tagset[selmon->seltags] = arg->ui & TAGMASK;
-    arrange();
+    dirtymon(selmon, DirtyAll);
+    flush();
 }
 
 void
 zoom(const Arg *arg) {
     Client *c = sel;
 
-    if (!mon_get_layout(selmon, selmon->sellt)->arrange || mon_get_layout(selmon, selmon->sellt)->arrange == monocle || (sel && sel->isfloating))
+    if (!c || !mon_get_layout(selmon, selmon->sellt)->arrange || mon_get_layout(selmon, selmon->sellt)->arrange == monocle || c->isfloating)
         return;
-    if (c == nexttiled(clients))
-        if (!c || !(c = nexttiled(c->next)))
+    if (c == nexttiled(c->mon->clients))
+        if (!(c = nexttiled(c->next)))
             return;
     detach(c);
     attach(c);
     focus(c);
-    arrange();
+    dirtymon(c->mon, DirtyLayout);
+    flush();
 }
 
 void
 movestack(const Arg *arg) {
-    Client *c = NULL, *p = NULL, *pc = NULL, *i;
+    Client *c = NULL, *i;
 
+    if(!sel)
+        return;
     if(arg->i > 0) {
-        for(c = sel->next; c && (!ISVISIBLE(c) || c->isfloating || c->mon != selmon); c = c->next);
+        for(c = sel->next; c && (!ISVISIBLE(c) || c->isfloating); c = c->next);
         if(!c)
-            for(c = clients; c && (!ISVISIBLE(c) || c->isfloating || c->mon != selmon); c = c->next);
-
+            for(c = sel->mon->clients; c && (!ISVISIBLE(c) || c->isfloating); c = c->next);
     }
     else {
-        for(i = clients; i != sel; i = i->next)
-            if(ISVISIBLE(i) && !i->isfloating && i->mon == selmon)
-                c = i;
+        for(c = sel->prev; c && (!ISVISIBLE(c) || c->isfloating); c = c->prev);
         if(!c)
-            for(; i; i = i->next)
-                if(ISVISIBLE(i) && !i->isfloating && i->mon == selmon)
+            for(i = sel->next; i; i = i->next)
+                if(ISVISIBLE(i) && !i->isfloating)
                     c = i;
     }
-    for(i = clients; i && (!p || !pc); i = i->next) {
-        if(i->next == sel)
-            p = i;
-        if(i->next == c)
-            pc = i;
-    }
 
     if(c && c != sel) {
-        Client *temp = sel->next==c?sel:sel->next;
-        sel->next = c->next==sel?c:c->next;
-        c->next = temp;
-
-        if(p && p != c)
-            p->next = c;
-        if(pc && pc != sel)
-            pc->next = sel;
-
-        if(sel == clients)
-            clients = c;
-        else if(c == clients)
-            clients = sel;
-
-        arrange();
+        swap(sel, c);
+        dirtymon(sel->mon, DirtyLayout);
+        flush();
     }
 }
 
@@ -1720,14 +4365,18 @@ focusmon(const Arg *arg) {
 
     if (target && target != selmon) {
         selmon = target;
-        for (Client *c = stack; c; c = c->snext) {
-            if (c->mon == selmon && ISFOCUSABLE(c)) {
+        holdflush++;
+        for (Client *c = selmon->stack; c; c = c->snext) {
+            if (ISFOCUSABLE(c)) {
                 focus(c);
                 break;
             }
         }
-        /* refresh bars */
-        for (Monitor *mm = mons; mm; mm = mm->next) drawbar(mm);
+        holdflush--;
+        /* every bar shows which monitor is selected */
+        for (Monitor *mm = mons; mm; mm = mm->next)
+            dirtymon(mm, DirtyBar);
+        flush();
     }
 }
 
@@ -1755,24 +4404,49 @@ sendmon(const Arg *arg) {
 
     if (!target || target == cur) return;
 
+    detach(sel);
+    detachstack(sel);
     sel->mon = target;
+    attach(sel);
+    attachstack(sel);
 
-    SetWindowPos(sel->hwnd, HWND_TOP, target->wx, target->wy, sel->w, sel->h, SWP_NOACTIVATE | SWP_SHOWWINDOW);
-
+    /* a floating window is moved right away, a tiled one by the target's
+     * layout in flush(), whose batch is committed before focus and the bars */
+    if (sel->isfloating)
+        resize(sel, target->wx, target->wy, sel->w, sel->h);
+    dirtyclient(sel);
+    dirtymon(cur, DirtyLayout | DirtyBar);
+    dirtymon(target, DirtyLayout | DirtyBar);
     if ((sel->tags & target->tagset[target->seltags]) == 0) {
         target->tagset[target->seltags] = sel->tags & TAGMASK;
+        dirtymon(target, DirtyVisibility);
     }
 
-    arrange();
+    flush();
 }
 
 int WINAPI
 wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nShowCmd) {
-    MSG msg;
+    MSG msg = { 0 };
     HANDLE mutex;
+    bool running = true;
+    wchar_t **argv, *recpath = NULL;
+    int argc, i;
 
     (void)hPrevInstance; (void)lpCmdLine; (void)nShowCmd;
 
+    /* before anything cleanup() would undo */
+    argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    for (i = 1; argv && i < argc; i++) {
+        if (!wcscmp(argv[i], L"-r") && i + 1 < argc)
+            recpath = argv[++i];     /* -r file: log events for replay */
+        else {
+            eprint(true, L"usage: dwm-win32 [-r file]\n");
+            LocalFree(argv);
+            return EXIT_FAILURE;
+        }
+    }
+
     SetProcessDPIAware();
 
     mutex = CreateMutexW(NULL, TRUE, NAME);
@@ -1781,11 +4455,36 @@ wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nSh
     if (GetLastError() == ERROR_ALREADY_EXISTS)
         die(L"dwm-win32 already running");
 
+    if (recpath)
+        startrecording(recpath);
+    LocalFree(argv);
+
     setup(hInstance);
 
-    while (GetMessage(&msg, NULL, 0, 0) > 0) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+    /* wake up for window messages as well as answered queries */
+    while (running) {
+        DWORD n = queries.event ? 1 : 0;   /* no workers left after cleanup() */
+        /* handlers may have queued events while a burst was processed */
+        DWORD wait = !eventdelay && (events.n || events.activated) ? 0 : INFINITE;
+        if (MsgWaitForMultipleObjectsEx(n, &queries.event, wait, QS_ALLINPUT,
+                                        MWMO_INPUTAVAILABLE) == WAIT_OBJECT_0 && n) {
+            PROFSTART(t);
+            completequeries();
+            PROFEND(&prof[ProfQueries], t);
+        }
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                running = false;
+                break;
+            }
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+        if (running && !eventdelay) {
+            PROFSTART(t);
+            processevents();
+            PROFEND(&prof[ProfEvents], t);
+        }
     }
 
     cleanup();
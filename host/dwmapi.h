@@ -0,0 +1,7 @@
+/* See LICENSE file for copyright and license details.
+ * Host build stand-in, see windows.h. */
+#pragma once
+#define DWMWA_EXTENDED_FRAME_BOUNDS 9
+#define DWMWA_CLOAKED 14
+HRESULT DwmGetWindowAttribute(HWND, DWORD, void *, DWORD); HRESULT DwmSetWindowAttribute(HWND, DWORD, const void *, DWORD);
+HRESULT DwmGetCompositionTimingInfo(HWND, void *);
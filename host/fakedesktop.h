@@ -0,0 +1,508 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * A desktop held in memory, for driving dwm-win32 on the host. It is a
+ * Platform backend: windows and monitors live in arrays, placements are
+ * applied to them at once and the foreground window is a variable. The
+ * fake*() calls play the part of the applications and of Windows, sending
+ * the WinEvents they would cause.
+ *
+ * Include it after dwm-win32.c, whose statics it uses, and build with
+ * host/win32.c.
+ */
+
+#define FAKEDESKTOP     ((HWND)(UINT_PTR)2)     /* not a multiple of 4 like the others */
+
+typedef struct {
+    bool alive, visible, cloaked;
+    DWORD pid;
+    ULONGLONG created;      /* of the process, a PID may come back later */
+    LONG style, exstyle;
+    HWND parent, owner;
+    RECT rect;              /* window rectangle, invisible borders included */
+    wchar_t classname[64];
+    wchar_t title[256];
+    wchar_t image[MAX_PATH];
+} FakeWindow;
+
+typedef struct {
+    RECT rc, work;
+} FakeMonitor;
+
+static struct {
+    FakeWindow *w;
+    unsigned int n, cap;
+    FakeMonitor mon[8];
+    unsigned int nmon;
+    POINT cursor;
+    HWND foreground;
+    RECT insets;            /* invisible borders of windows with a caption */
+    ULONGLONG clock;        /* hands out process creation times */
+    unsigned long placed;   /* windows moved, sized, shown or hidden */
+    unsigned long closed;
+    unsigned long framequeries;     /* DWM asked for the invisible borders */
+    unsigned long imagequeries;     /* processes opened for their image */
+} fake;
+
+static HWND
+fakehwnd(unsigned int i) {
+    return (HWND)(UINT_PTR)((i + 1) * 4);
+}
+
+/* The window behind hwnd, NULL for our bars and whatever isn't ours. */
+static FakeWindow *
+fakew(HWND hwnd) {
+    UINT_PTR i = (UINT_PTR)hwnd / 4;
+
+    if ((UINT_PTR)hwnd % 4 || i < 1 || i > fake.n)
+        return NULL;
+    return &fake.w[i - 1];
+}
+
+static HMONITOR
+fakehmon(unsigned int i) {
+    return (HMONITOR)(UINT_PTR)(i + 1);
+}
+
+static bool
+fakeinside(const RECT *r, POINT pt) {
+    return pt.x >= r->left && pt.x < r->right && pt.y >= r->top && pt.y < r->bottom;
+}
+
+static HMONITOR
+fakepointmonitor(POINT pt) {
+    for (unsigned int i = 0; i < fake.nmon; i++)
+        if (fakeinside(&fake.mon[i].rc, pt))
+            return fakehmon(i);
+    return fake.nmon ? fakehmon(0) : NULL;
+}
+
+static HMONITOR
+fakewindowmonitor(HWND hwnd) {
+    FakeWindow *w = fakew(hwnd);
+    POINT pt = { 0, 0 };
+
+    if (w) {
+        pt.x = (w->rect.left + w->rect.right) / 2;
+        pt.y = (w->rect.top + w->rect.bottom) / 2;
+    }
+    return fakepointmonitor(pt);
+}
+
+static BOOL
+fakeenumwindows(WNDENUMPROC f, LPARAM lp) {
+    for (unsigned int i = 0; i < fake.n; i++)
+        if (fake.w[i].alive && !f(fakehwnd(i), lp))
+            return FALSE;
+    return TRUE;
+}
+
+static HWND
+fakefindwindow(const wchar_t *class, const wchar_t *title) {
+    for (unsigned int i = 0; i < fake.n; i++)
+        if (fake.w[i].alive && (!class || !wcscmp(fake.w[i].classname, class))
+        && (!title || !wcscmp(fake.w[i].title, title)))
+            return fakehwnd(i);
+    return NULL;
+}
+
+static HWND
+fakedesktop(void) {
+    return FAKEDESKTOP;
+}
+
+static BOOL
+fakeenummonitors(MONITORENUMPROC f, LPARAM lp) {
+    for (unsigned int i = 0; i < fake.nmon; i++)
+        if (!f(fakehmon(i), NULL, &fake.mon[i].rc, lp))
+            return FALSE;
+    return TRUE;
+}
+
+static BOOL
+fakemonitorinfo(HMONITOR hmon, MONITORINFOEXW *mi) {
+    UINT_PTR i = (UINT_PTR)hmon - 1;
+
+    if (i >= fake.nmon)
+        return FALSE;
+    mi->rcMonitor = fake.mon[i].rc;
+    mi->rcWork = fake.mon[i].work;
+    mi->dwFlags = i == 0;
+    swprintf(mi->szDevice, LENGTH(mi->szDevice), L"\\\\.\\DISPLAY%u", (unsigned)i + 1);
+    return TRUE;
+}
+
+static BOOL
+fakecursorpos(POINT *pt) {
+    *pt = fake.cursor;
+    return TRUE;
+}
+
+static int
+fakemetric(int index) {
+    RECT r = { 0, 0, 0, 0 };
+
+    for (unsigned int i = 0; i < fake.nmon; i++) {
+        RECT *m = &fake.mon[i].rc;
+        if (!i || m->left < r.left) r.left = m->left;
+        if (!i || m->top < r.top) r.top = m->top;
+        if (!i || m->right > r.right) r.right = m->right;
+        if (!i || m->bottom > r.bottom) r.bottom = m->bottom;
+    }
+    switch (index) {
+    case SM_XVIRTUALSCREEN: return r.left;
+    case SM_YVIRTUALSCREEN: return r.top;
+    case SM_CXVIRTUALSCREEN: return r.right - r.left;
+    case SM_CYVIRTUALSCREEN: return r.bottom - r.top;
+    }
+    return 0;
+}
+
+static BOOL
+fakewindowinfo(HWND hwnd, WINDOWINFO *wi) {
+    FakeWindow *w = fakew(hwnd);
+
+    if (!w || !w->alive)
+        return FALSE;
+    wi->rcWindow = wi->rcClient = w->rect;
+    wi->dwStyle = w->style;
+    wi->dwExStyle = w->exstyle;
+    return TRUE;
+}
+
+static DWORD
+fakewindowthread(HWND hwnd, DWORD *pid) {
+    FakeWindow *w = fakew(hwnd);
+
+    if (pid)
+        *pid = w ? w->pid : 0;
+    return w ? w->pid : 0;
+}
+
+static BOOL
+fakeiswindow(HWND hwnd) {
+    FakeWindow *w = fakew(hwnd);
+
+    return w && w->alive;
+}
+
+static HWND
+fakeparent(HWND hwnd) {
+    FakeWindow *w = fakew(hwnd);
+
+    return w ? w->parent : NULL;
+}
+
+static HWND
+fakeowner(HWND hwnd) {
+    FakeWindow *w = fakew(hwnd);
+
+    return w ? w->owner : NULL;
+}
+
+static LONG
+fakestyle(HWND hwnd, int index) {
+    FakeWindow *w = fakew(hwnd);
+
+    if (!w)
+        return 0;
+    return index == GWL_EXSTYLE ? w->exstyle : w->style;
+}
+
+static BOOL
+fakevisible(HWND hwnd) {
+    FakeWindow *w = fakew(hwnd);
+
+    return w && w->visible;
+}
+
+static bool
+fakecloaked(HWND hwnd) {
+    FakeWindow *w = fakew(hwnd);
+
+    return w && w->cloaked;
+}
+
+static bool
+fakeframeinsets(HWND hwnd, RECT *insets) {
+    FakeWindow *w = fakew(hwnd);
+    RECT none = { 0, 0, 0, 0 };
+
+    fake.framequeries++;
+    if (!w || !w->alive)
+        return false;
+    *insets = (w->style & WS_CAPTION) ? fake.insets : none;
+    return true;
+}
+
+static HRESULT
+fakesetattribute(HWND hwnd, DWORD attr, const void *val, DWORD size) {
+    return fakeiswindow(hwnd) ? S_OK : -1;
+}
+
+static int
+fakestring(const wchar_t *s, wchar_t *buf, int len) {
+    if (len <= 0)
+        return 0;
+    wcsncpy(buf, s, len - 1);
+    buf[len - 1] = L'\0';
+    return (int)wcslen(buf);
+}
+
+static int
+fakeclassname(HWND hwnd, wchar_t *buf, int len) {
+    FakeWindow *w = fakew(hwnd);
+
+    return w ? fakestring(w->classname, buf, len) : 0;
+}
+
+static int
+faketitle(HWND hwnd, wchar_t *buf, int len) {
+    FakeWindow *w = fakew(hwnd);
+
+    return w ? fakestring(w->title, buf, len) : 0;
+}
+
+static bool
+fakeprocessimage(DWORD pid, wchar_t *buf, DWORD *len, ULONGLONG *created) {
+    fake.imagequeries++;
+    for (unsigned int i = 0; i < fake.n; i++) {
+        FakeWindow *w = &fake.w[i];
+        if (w->alive && w->pid == pid && w->image[0]) {
+            *len = (DWORD)fakestring(w->image, buf, (int)*len);
+            *created = w->created;
+            return true;
+        }
+    }
+    return false;
+}
+
+static BOOL
+fakesetwindowpos(HWND hwnd, HWND after, int x, int y, int cx, int cy, UINT flags) {
+    FakeWindow *w = fakew(hwnd);
+
+    if (!w || !w->alive)
+        return FALSE;
+    if (!(flags & SWP_NOMOVE)) {
+        w->rect.right += x - w->rect.left;
+        w->rect.bottom += y - w->rect.top;
+        w->rect.left = x;
+        w->rect.top = y;
+    }
+    if (!(flags & SWP_NOSIZE)) {
+        w->rect.right = w->rect.left + cx;
+        w->rect.bottom = w->rect.top + cy;
+    }
+    if (flags & SWP_SHOWWINDOW)
+        w->visible = true;
+    if (flags & SWP_HIDEWINDOW)
+        w->visible = false;
+    fake.placed++;
+    return TRUE;
+}
+
+static HDWP
+fakebegindefer(int n) {
+    return (HDWP)FAKEDESKTOP;
+}
+
+/* applied at once, the batch can't fail half way here */
+static HDWP
+fakedefer(HDWP hdwp, HWND hwnd, HWND after, int x, int y, int cx, int cy, UINT flags) {
+    return fakesetwindowpos(hwnd, after, x, y, cx, cy, flags) ? hdwp : NULL;
+}
+
+static BOOL
+fakeenddefer(HDWP hdwp) {
+    return TRUE;
+}
+
+static BOOL
+fakesetplacement(HWND hwnd, const WINDOWPLACEMENT *wp) {
+    return fakeiswindow(hwnd);
+}
+
+static BOOL
+fakeforeground(HWND hwnd) {
+    fake.foreground = hwnd;
+    return TRUE;
+}
+
+static BOOL
+fakeclose(HWND hwnd) {
+    fake.closed++;
+    return fakeiswindow(hwnd);
+}
+
+static BOOL
+fakeshellhook(HWND hwnd, bool on) {
+    return TRUE;
+}
+
+static HWINEVENTHOOK
+fakehookevents(DWORD min, DWORD max, WINEVENTPROC f) {
+    return (HWINEVENTHOOK)(UINT_PTR)min;
+}
+
+static BOOL
+fakeunhookevents(HWINEVENTHOOK hook) {
+    return TRUE;
+}
+
+static BOOL
+fakeregisterhotkey(HWND hwnd, int id, UINT mod, UINT key) {
+    return TRUE;
+}
+
+static BOOL
+fakeunregisterhotkey(HWND hwnd, int id) {
+    return TRUE;
+}
+
+static const Platform fakeplatform = {
+    .enumwindows = fakeenumwindows,
+    .findwindow = fakefindwindow,
+    .desktop = fakedesktop,
+    .enummonitors = fakeenummonitors,
+    .monitorinfo = fakemonitorinfo,
+    .windowmonitor = fakewindowmonitor,
+    .pointmonitor = fakepointmonitor,
+    .cursorpos = fakecursorpos,
+    .metric = fakemetric,
+    .windowinfo = fakewindowinfo,
+    .windowthread = fakewindowthread,
+    .iswindow = fakeiswindow,
+    .parent = fakeparent,
+    .owner = fakeowner,
+    .style = fakestyle,
+    .visible = fakevisible,
+    .cloaked = fakecloaked,
+    .frameinsets = fakeframeinsets,
+    .setattribute = fakesetattribute,
+    .classname = fakeclassname,
+    .title = faketitle,
+    .processimage = fakeprocessimage,
+    .setwindowpos = fakesetwindowpos,
+    .begindefer = fakebegindefer,
+    .defer = fakedefer,
+    .enddefer = fakeenddefer,
+    .setplacement = fakesetplacement,
+    .foreground = fakeforeground,
+    .close = fakeclose,
+    .shellhook = fakeshellhook,
+    .hookevents = fakehookevents,
+    .unhookevents = fakeunhookevents,
+    .registerhotkey = fakeregisterhotkey,
+    .unregisterhotkey = fakeunregisterhotkey,
+};
+
+/* the applications and Windows */
+
+void
+fakemonitor(int x, int y, int w, int h) {
+    FakeMonitor *m;
+
+    if (fake.nmon == LENGTH(fake.mon))
+        die(L"fake: too many monitors\n");
+    m = &fake.mon[fake.nmon++];
+    m->rc = (RECT){ x, y, x + w, y + h };
+    m->work = m->rc;
+}
+
+/* A new top level window, created visible but not announced yet. */
+HWND
+fakewindow(const wchar_t *class, const wchar_t *title, const wchar_t *image, DWORD pid, RECT r) {
+    FakeWindow *w;
+
+    if (fake.n == fake.cap) {
+        fake.cap = fake.cap ? fake.cap * 2 : 64;
+        if (!(w = realloc(fake.w, fake.cap * sizeof(FakeWindow))))
+            die(L"fake: could not realloc() %u windows\n", fake.cap);
+        fake.w = w;
+    }
+    w = &fake.w[fake.n];
+    memset(w, 0, sizeof(*w));
+    w->alive = w->visible = true;
+    w->pid = pid;
+    w->created = ++fake.clock;
+    for (unsigned int i = 0; i < fake.n; i++)
+        if (fake.w[i].alive && fake.w[i].pid == pid)
+            w->created = fake.w[i].created;
+    w->style = WS_CAPTION | WS_MINIMIZEBOX | WS_MAXIMIZEBOX;
+    w->rect = r;
+    fakestring(class, w->classname, (int)LENGTH(w->classname));
+    fakestring(title, w->title, (int)LENGTH(w->title));
+    fakestring(image ? image : L"", w->image, (int)LENGTH(w->image));
+    return fakehwnd(fake.n++);
+}
+
+void
+fakeevent(DWORD event, HWND hwnd) {
+    wineventproc(NULL, event, hwnd, OBJID_WINDOW, CHILDID_SELF, 0, 0);
+}
+
+void
+fakeshell(DWORD code, HWND hwnd) {
+    WndProc(dwmhwnd, shellhookid, code, (LPARAM)hwnd);
+}
+
+/* What the workers would do, on this thread and in order. */
+void
+fakequeries(void) {
+    Query *q;
+
+    while ((q = queries.jobs)) {
+        if (!(queries.jobs = q->next))
+            queries.jobstail = &queries.jobs;
+        runquery(q);
+        q->next = queries.done;
+        queries.done = q;
+    }
+    completequeries();
+}
+
+/* Lets the window manager catch up, as the message loop would. */
+void
+fakesettle(void) {
+    processevents();
+    fakequeries();
+}
+
+HWND
+fakeopen(const wchar_t *class, const wchar_t *title, const wchar_t *image, DWORD pid) {
+    HWND hwnd = fakewindow(class, title, image, pid, (RECT){ 100, 100, 740, 580 });
+
+    fakeevent(EVENT_OBJECT_CREATE, hwnd);
+    fakeevent(EVENT_OBJECT_SHOW, hwnd);
+    return hwnd;
+}
+
+void
+fakedestroy(HWND hwnd) {
+    FakeWindow *w = fakew(hwnd);
+
+    w->alive = w->visible = false;
+    if (fake.foreground == hwnd)
+        fake.foreground = NULL;
+    fakeevent(EVENT_OBJECT_HIDE, hwnd);
+    fakeevent(EVENT_OBJECT_DESTROY, hwnd);
+}
+
+/* The user clicking on hwnd. */
+void
+fakeactivate(HWND hwnd) {
+    FakeWindow *w = fakew(hwnd);
+
+    fake.foreground = hwnd;
+    fake.cursor.x = (w->rect.left + w->rect.right) / 2;
+    fake.cursor.y = (w->rect.top + w->rect.bottom) / 2;
+    fakeshell(HSHELL_WINDOWACTIVATED, hwnd);
+}
+
+/* Switches dwm-win32 over to the fake desktop and runs its setup, the
+ * monitors and the windows already open must be in place. */
+void
+fakestart(void) {
+    pf = &fakeplatform;
+    setup(NULL);
+    fakequeries();
+}
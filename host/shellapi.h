@@ -0,0 +1,4 @@
+/* See LICENSE file for copyright and license details.
+ * Host build stand-in, see windows.h. */
+#pragma once
+HINSTANCE ShellExecuteW(HWND, LPCWSTR, LPCWSTR, LPCWSTR, LPCWSTR, int);
@@ -0,0 +1,317 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Definitions for the declarations in host/windows.h. What dwm-win32 asks
+ * of the desktop goes through its Platform table, which the host programs
+ * replace with host/fakedesktop.h, so everything here is inert: window and
+ * GDI calls succeed without doing anything, threads are never started and
+ * locks are no-ops, since the host programs are single threaded. Only time,
+ * memory, strings and files do the real thing.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "windows.h"
+#include "dwmapi.h"
+#include "shellapi.h"
+
+#define DUMMY ((HANDLE)(INT_PTR)0x1000)     /* a handle that is not NULL */
+
+static DWORD lasterror;
+static UINT_PTR nextwindow = 0x7f000000;    /* above the fake desktop windows */
+
+/* time */
+
+static ULONGLONG
+nanoseconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ULONGLONG)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+BOOL
+QueryPerformanceCounter(LARGE_INTEGER *t) {
+    t->QuadPart = (LONGLONG)nanoseconds();
+    return TRUE;
+}
+
+BOOL
+QueryPerformanceFrequency(LARGE_INTEGER *f) {
+    f->QuadPart = 1000000000;
+    return TRUE;
+}
+
+ULONGLONG
+GetTickCount64(void) {
+    return nanoseconds() / 1000000;
+}
+
+DWORD
+GetTickCount(void) {
+    return (DWORD)GetTickCount64();
+}
+
+void
+Sleep(DWORD ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000 };
+
+    nanosleep(&ts, NULL);
+}
+
+/* memory */
+
+LPVOID
+VirtualAlloc(LPVOID p, size_t size, DWORD type, DWORD protect) {
+    return calloc(1, size);
+}
+
+BOOL
+VirtualFree(LPVOID p, size_t size, DWORD type) {
+    free(p);
+    return TRUE;
+}
+
+HLOCAL
+LocalFree(HLOCAL p) {
+    free(p);
+    return NULL;
+}
+
+/* strings */
+
+DWORD
+GetLastError(void) {
+    return lasterror;
+}
+
+void
+SetLastError(DWORD e) {
+    lasterror = e;
+}
+
+int
+_vscwprintf(const wchar_t *fmt, va_list ap) {
+    wchar_t *buf = NULL;
+    size_t len = 256;
+    va_list aq;
+    int n;
+
+    for (;;) {
+        if (!(buf = realloc(buf, len * sizeof(wchar_t))))
+            return -1;
+        va_copy(aq, ap);
+        n = vswprintf(buf, len, fmt, aq);
+        va_end(aq);
+        if (n >= 0 || len >= 1 << 20)
+            break;
+        len *= 2;
+    }
+    free(buf);
+    return n;
+}
+
+int
+wcscpy_s(wchar_t *dst, size_t size, const wchar_t *src) {
+    if (!dst || !src || wcslen(src) >= size)
+        return 1;
+    wcscpy(dst, src);
+    return 0;
+}
+
+/* UTF-8 only, like the callers. Fails with ERROR_INSUFFICIENT_BUFFER if
+ * wn is too small, having filled in what fit. */
+int
+MultiByteToWideChar(UINT cp, DWORD flags, LPCSTR s, int n, LPWSTR w, int wn) {
+    const unsigned char *p = (const unsigned char *)s, *end;
+    int i = 0, k;
+    DWORD ch;
+
+    end = n < 0 ? p + strlen(s) + 1 : p + n;
+    while (p < end) {
+        ch = *p++;
+        k = ch >= 0xf0 ? 3 : ch >= 0xe0 ? 2 : ch >= 0xc0 ? 1 : 0;
+        if (k)
+            ch &= 0x3f >> k;
+        for (; k && p < end; k--)
+            ch = ch << 6 | (*p++ & 0x3f);
+        if (wn) {
+            if (i == wn) {
+                lasterror = ERROR_INSUFFICIENT_BUFFER;
+                return 0;
+            }
+            w[i] = (wchar_t)ch;
+        }
+        i++;
+    }
+    return i;
+}
+
+int
+WideCharToMultiByte(UINT cp, DWORD flags, LPCWSTR w, int wn, LPSTR s, int n, LPCSTR def, BOOL *used) {
+    int i, len = wn < 0 ? (int)wcslen(w) + 1 : wn;
+
+    if (!n)
+        return len;
+    for (i = 0; i < len && i < n; i++)
+        s[i] = w[i] < 0x80 ? (char)w[i] : '?';
+    return i;
+}
+
+/* files */
+
+FILE *
+_wfopen(const wchar_t *path, const wchar_t *mode) {
+    char p[4096], m[16];
+
+    if (wcstombs(p, path, sizeof p) == (size_t)-1 || wcstombs(m, mode, sizeof m) == (size_t)-1)
+        return NULL;
+    return fopen(p, m);
+}
+
+void
+OutputDebugStringW(LPCWSTR s) {
+    fprintf(stderr, "%ls", s);
+}
+
+int
+MessageBoxW(HWND hwnd, LPCWSTR text, LPCWSTR caption, UINT type) {
+    fprintf(stderr, "%ls: %ls\n", caption ? caption : L"", text);
+    return 1;
+}
+
+LPWSTR GetCommandLineW(void) { return L""; }
+LPWSTR *CommandLineToArgvW(LPCWSTR cmd, int *argc) { *argc = 0; return NULL; }
+HANDLE CreateFileW(LPCWSTR path, DWORD access, DWORD share, SECURITY_ATTRIBUTES *sa, DWORD disp, DWORD flags, HANDLE t) { return INVALID_HANDLE_VALUE; }
+BOOL ReadFile(HANDLE h, LPVOID buf, DWORD n, LPDWORD read, OVERLAPPED *o) { return FALSE; }
+BOOL WriteFile(HANDLE h, LPCVOID buf, DWORD n, LPDWORD written, OVERLAPPED *o) { return FALSE; }
+BOOL FlushFileBuffers(HANDLE h) { return TRUE; }
+BOOL GetFileSizeEx(HANDLE h, LARGE_INTEGER *size) { return FALSE; }
+BOOL SetFilePointerEx(HANDLE h, LARGE_INTEGER off, LARGE_INTEGER *pos, DWORD how) { return FALSE; }
+BOOL GetFileAttributesExW(LPCWSTR path, GET_FILEEX_INFO_LEVELS l, void *info) { return FALSE; }
+LONG CompareFileTime(const FILETIME *a, const FILETIME *b) { return 0; }
+HANDLE CreateNamedPipeW(LPCWSTR name, DWORD mode, DWORD pmode, DWORD max, DWORD out, DWORD in, DWORD t, SECURITY_ATTRIBUTES *sa) { return INVALID_HANDLE_VALUE; }
+BOOL ConnectNamedPipe(HANDLE h, OVERLAPPED *o) { return FALSE; }
+BOOL DisconnectNamedPipe(HANDLE h) { return TRUE; }
+BOOL CancelSynchronousIo(HANDLE h) { return TRUE; }
+
+/* processes, threads and synchronization */
+
+HANDLE CreateThread(SECURITY_ATTRIBUTES *sa, size_t stack, LPTHREAD_START_ROUTINE f, LPVOID arg, DWORD flags, LPDWORD id) { return DUMMY; }
+HANDLE CreateEventW(SECURITY_ATTRIBUTES *sa, BOOL manual, BOOL initial, LPCWSTR name) { return DUMMY; }
+HANDLE CreateMutexW(SECURITY_ATTRIBUTES *sa, BOOL owner, LPCWSTR name) { return DUMMY; }
+BOOL SetEvent(HANDLE h) { return TRUE; }
+BOOL CloseHandle(HANDLE h) { return TRUE; }
+DWORD WaitForSingleObject(HANDLE h, DWORD ms) { return WAIT_OBJECT_0; }
+DWORD WaitForMultipleObjects(DWORD n, const HANDLE *h, BOOL all, DWORD ms) { return WAIT_OBJECT_0; }
+DWORD MsgWaitForMultipleObjects(DWORD n, const HANDLE *h, BOOL all, DWORD ms, DWORD mask) { return WAIT_OBJECT_0; }
+DWORD MsgWaitForMultipleObjectsEx(DWORD n, const HANDLE *h, DWORD ms, DWORD mask, DWORD flags) { return WAIT_TIMEOUT; }
+void InitializeSRWLock(SRWLOCK *l) { }
+void AcquireSRWLockExclusive(SRWLOCK *l) { }
+void ReleaseSRWLockExclusive(SRWLOCK *l) { }
+void InitializeConditionVariable(CONDITION_VARIABLE *cv) { }
+BOOL SleepConditionVariableSRW(CONDITION_VARIABLE *cv, SRWLOCK *l, DWORD ms, ULONG_PTR flags) { return TRUE; }
+void WakeConditionVariable(CONDITION_VARIABLE *cv) { }
+void WakeAllConditionVariable(CONDITION_VARIABLE *cv) { }
+HANDLE OpenProcess(DWORD access, BOOL inherit, DWORD pid) { return NULL; }
+BOOL QueryFullProcessImageNameW(HANDLE h, DWORD flags, LPWSTR buf, LPDWORD n) { return FALSE; }
+BOOL GetProcessTimes(HANDLE h, FILETIME *c, FILETIME *e, FILETIME *k, FILETIME *u) { return FALSE; }
+HINSTANCE ShellExecuteW(HWND hwnd, LPCWSTR op, LPCWSTR file, LPCWSTR params, LPCWSTR dir, int show) { return NULL; }
+
+/* our own windows and messages */
+
+HWND
+CreateWindowExW(DWORD exstyle, LPCWSTR class, LPCWSTR name, DWORD style, int x, int y, int w, int h,
+                HWND parent, HMENU menu, HINSTANCE inst, LPVOID param) {
+    nextwindow += 4;
+    return (HWND)nextwindow;
+}
+
+unsigned short RegisterClassExW(const WNDCLASSEXW *wc) { return 1; }
+unsigned short RegisterClassW(const WNDCLASSW *wc) { return 1; }
+UINT RegisterWindowMessageW(LPCWSTR name) { return 0xc000; }
+BOOL DestroyWindow(HWND hwnd) { return TRUE; }
+LRESULT DefWindowProcW(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) { return 0; }
+BOOL PostMessageW(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) { return TRUE; }
+LRESULT SendMessage(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) { return 0; }
+BOOL PeekMessageW(LPMSG msg, HWND hwnd, UINT min, UINT max, UINT remove) { return FALSE; }
+BOOL TranslateMessage(const MSG *msg) { return FALSE; }
+LRESULT DispatchMessageW(const MSG *msg) { return 0; }
+void PostQuitMessage(int code) { }
+UINT_PTR SetTimer(HWND hwnd, UINT_PTR id, UINT ms, TIMERPROC f) { return id; }
+BOOL KillTimer(HWND hwnd, UINT_PTR id) { return TRUE; }
+HCURSOR LoadCursorW(HINSTANCE inst, LPCWSTR name) { return NULL; }
+SHORT GetKeyState(int key) { return 0; }
+BOOL SetProcessDPIAware(void) { return TRUE; }
+BOOL SystemParametersInfoW(UINT action, UINT param, void *p, UINT flags) { return TRUE; }
+DWORD GetSysColor(int i) { return 0; }
+BOOL SetSysColors(int n, const int *elements, const COLORREF *colors) { return TRUE; }
+BOOL EnumDisplaySettingsW(LPCWSTR device, DWORD mode, DEVMODEW *dm) { return FALSE; }
+
+/* drawing */
+
+BOOL
+GetTextExtentPoint32W(HDC hdc, LPCWSTR s, int n, SIZE *sz) {
+    sz->cx = 8 * n;
+    sz->cy = 16;
+    return TRUE;
+}
+
+HDC GetWindowDC(HWND hwnd) { return NULL; }
+HDC GetDC(HWND hwnd) { return NULL; }
+int ReleaseDC(HWND hwnd, HDC hdc) { return 1; }
+HDC BeginPaint(HWND hwnd, PAINTSTRUCT *ps) { memset(ps, 0, sizeof(*ps)); return NULL; }
+BOOL EndPaint(HWND hwnd, const PAINTSTRUCT *ps) { return TRUE; }
+HDC CreateCompatibleDC(HDC hdc) { return NULL; }
+BOOL DeleteDC(HDC hdc) { return TRUE; }
+HBITMAP CreateDIBSection(HDC hdc, const BITMAPINFO *bmi, UINT usage, void **bits, HANDLE section, DWORD offset) { return NULL; }
+BOOL BitBlt(HDC dst, int x, int y, int w, int h, HDC src, int sx, int sy, DWORD rop) { return TRUE; }
+BOOL DeleteObject(HGDIOBJ o) { return TRUE; }
+HGDIOBJ SelectObject(HDC hdc, HGDIOBJ o) { return NULL; }
+HGDIOBJ GetStockObject(int i) { return NULL; }
+HBRUSH CreateSolidBrush(COLORREF c) { return NULL; }
+HPEN CreatePen(int style, int w, COLORREF c) { return NULL; }
+HFONT CreateFontW(int h, int w, int esc, int orient, int weight, DWORD italic, DWORD underline, DWORD strike,
+                  DWORD charset, DWORD prec, DWORD clip, DWORD quality, DWORD pitch, LPCWSTR face) { return NULL; }
+int FillRect(HDC hdc, const RECT *r, HBRUSH b) { return 1; }
+int SetBkMode(HDC hdc, int mode) { return 1; }
+COLORREF SetTextColor(HDC hdc, COLORREF c) { return 0; }
+int DrawTextW(HDC hdc, LPCWSTR s, int n, LPRECT r, UINT format) { return 16; }
+
+/* the desktop, only reached by the win32 Platform the host programs replace */
+
+BOOL EnumWindows(WNDENUMPROC f, LPARAM lp) { return TRUE; }
+HWND FindWindowW(LPCWSTR class, LPCWSTR title) { return NULL; }
+HWND GetDesktopWindow(void) { return NULL; }
+BOOL SetForegroundWindow(HWND hwnd) { return TRUE; }
+HWND GetWindow(HWND hwnd, UINT cmd) { return NULL; }
+HWND GetParent(HWND hwnd) { return NULL; }
+LONG GetWindowLongW(HWND hwnd, int i) { return 0; }
+BOOL IsWindow(HWND hwnd) { return FALSE; }
+BOOL IsWindowVisible(HWND hwnd) { return FALSE; }
+BOOL GetWindowRect(HWND hwnd, LPRECT r) { return FALSE; }
+BOOL GetWindowInfo(HWND hwnd, WINDOWINFO *wi) { return FALSE; }
+int GetClassNameW(HWND hwnd, LPWSTR buf, int n) { return 0; }
+int InternalGetWindowText(HWND hwnd, LPWSTR buf, int n) { return 0; }
+DWORD GetWindowThreadProcessId(HWND hwnd, LPDWORD pid) { return 0; }
+BOOL SetWindowPlacement(HWND hwnd, const WINDOWPLACEMENT *wp) { return TRUE; }
+BOOL SetWindowPos(HWND hwnd, HWND after, int x, int y, int w, int h, UINT flags) { return TRUE; }
+HDWP BeginDeferWindowPos(int n) { return DUMMY; }
+HDWP DeferWindowPos(HDWP d, HWND hwnd, HWND after, int x, int y, int w, int h, UINT flags) { return d; }
+BOOL EndDeferWindowPos(HDWP d) { return TRUE; }
+BOOL GetCursorPos(LPPOINT pt) { pt->x = pt->y = 0; return TRUE; }
+int GetSystemMetrics(int i) { return 0; }
+HMONITOR MonitorFromWindow(HWND hwnd, DWORD flags) { return NULL; }
+HMONITOR MonitorFromPoint(POINT pt, DWORD flags) { return NULL; }
+BOOL GetMonitorInfoW(HMONITOR hmon, MONITORINFO *mi) { return FALSE; }
+BOOL EnumDisplayMonitors(HDC hdc, LPCRECT clip, MONITORENUMPROC f, LPARAM lp) { return TRUE; }
+BOOL RegisterHotKey(HWND hwnd, int id, UINT mod, UINT key) { return TRUE; }
+BOOL UnregisterHotKey(HWND hwnd, int id) { return TRUE; }
+BOOL RegisterShellHookWindow(HWND hwnd) { return TRUE; }
+BOOL DeregisterShellHookWindow(HWND hwnd) { return TRUE; }
+HWINEVENTHOOK SetWinEventHook(DWORD min, DWORD max, HMODULE mod, WINEVENTPROC f, DWORD pid, DWORD tid, DWORD flags) { return NULL; }
+BOOL UnhookWinEvent(HWINEVENTHOOK hook) { return TRUE; }
+HRESULT DwmGetWindowAttribute(HWND hwnd, DWORD attr, void *val, DWORD size) { return -1; }
+HRESULT DwmSetWindowAttribute(HWND hwnd, DWORD attr, const void *val, DWORD size) { return -1; }
@@ -0,0 +1,300 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * The part of the Windows API dwm-win32 uses, declared for host builds of
+ * the tests and benchmarks; host/win32.c has inert definitions. Integer
+ * types have their Windows sizes so the -r log reads the same, wchar_t
+ * stays the 32-bit one of the C library.
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <wchar.h>
+#define WINAPI
+#define CALLBACK
+#define APIENTRY
+typedef int BOOL; typedef unsigned int UINT; typedef uint32_t DWORD; typedef int32_t LONG;
+typedef unsigned short WORD; typedef unsigned char BYTE; typedef short SHORT;
+typedef long long LONGLONG; typedef unsigned long long ULONGLONG; typedef unsigned long long ULONG_PTR;
+typedef intptr_t INT_PTR; typedef uintptr_t UINT_PTR; typedef intptr_t LONG_PTR; typedef uintptr_t DWORD_PTR;
+typedef UINT_PTR WPARAM; typedef LONG_PTR LPARAM; typedef LONG_PTR LRESULT; typedef int32_t HRESULT;
+typedef DWORD COLORREF; typedef void *HANDLE; typedef void *LPVOID; typedef const void *LPCVOID;
+typedef wchar_t WCHAR; typedef wchar_t *LPWSTR; typedef const wchar_t *LPCWSTR; typedef char *LPSTR; typedef const char *LPCSTR;
+typedef DWORD *LPDWORD; typedef BYTE *LPBYTE;
+#define DECLARE_HANDLE(n) typedef struct n##__ { int unused; } *n
+DECLARE_HANDLE(HWND); DECLARE_HANDLE(HMONITOR); DECLARE_HANDLE(HDC); DECLARE_HANDLE(HINSTANCE);
+DECLARE_HANDLE(HWINEVENTHOOK); DECLARE_HANDLE(HICON); DECLARE_HANDLE(HCURSOR); DECLARE_HANDLE(HMENU);
+DECLARE_HANDLE(HBITMAP); DECLARE_HANDLE(HKEY);
+typedef void *HGDIOBJ; typedef HGDIOBJ HPEN; typedef HGDIOBJ HBRUSH; typedef HGDIOBJ HFONT;
+typedef HANDLE HDWP; typedef HINSTANCE HMODULE;
+typedef struct { LONG left, top, right, bottom; } RECT, *LPRECT; typedef const RECT *LPCRECT;
+typedef struct { LONG x, y; } POINT, *LPPOINT; typedef struct { SHORT x, y; } POINTS; typedef struct { LONG cx, cy; } SIZE;
+typedef union { struct { DWORD LowPart; LONG HighPart; } u; LONGLONG QuadPart; } LARGE_INTEGER;
+typedef struct { DWORD dwLowDateTime, dwHighDateTime; } FILETIME;
+typedef struct { HWND hwnd; UINT message; WPARAM wParam; LPARAM lParam; DWORD time; POINT pt; } MSG, *LPMSG;
+typedef LRESULT (CALLBACK *WNDPROC)(HWND, UINT, WPARAM, LPARAM);
+typedef struct { UINT cbSize, style; WNDPROC lpfnWndProc; int cbClsExtra, cbWndExtra; HINSTANCE hInstance; HICON hIcon; HCURSOR hCursor; HBRUSH hbrBackground; LPCWSTR lpszMenuName, lpszClassName; HICON hIconSm; } WNDCLASSEXW;
+typedef struct { UINT style; WNDPROC lpfnWndProc; int cbClsExtra, cbWndExtra; HINSTANCE hInstance; HICON hIcon; HCURSOR hCursor; HBRUSH hbrBackground; LPCWSTR lpszMenuName, lpszClassName; } WNDCLASSW;
+typedef struct { DWORD cbSize; RECT rcWindow, rcClient; DWORD dwStyle, dwExStyle, dwWindowStatus; UINT cxWindowBorders, cyWindowBorders; WORD atomWindowType, wCreatorVersion; } WINDOWINFO;
+typedef struct { UINT length, flags, showCmd; POINT ptMinPosition, ptMaxPosition; RECT rcNormalPosition; } WINDOWPLACEMENT;
+typedef struct { DWORD cbSize; RECT rcMonitor, rcWork; DWORD dwFlags; } MONITORINFO;
+typedef struct { DWORD cbSize; RECT rcMonitor, rcWork; DWORD dwFlags; WCHAR szDevice[32]; } MONITORINFOEXW;
+typedef struct { HDC hdc; BOOL fErase; RECT rcPaint; } PAINTSTRUCT;
+typedef struct { DWORD biSize; LONG biWidth, biHeight; WORD biPlanes, biBitCount; DWORD biCompression, biSizeImage; LONG biXPelsPerMeter, biYPelsPerMeter; DWORD biClrUsed, biClrImportant; } BITMAPINFOHEADER;
+typedef struct { BYTE rgbBlue, rgbGreen, rgbRed, rgbReserved; } RGBQUAD;
+typedef struct { BITMAPINFOHEADER bmiHeader; RGBQUAD bmiColors[1]; } BITMAPINFO;
+typedef struct { DWORD nLength; LPVOID lpSecurityDescriptor; BOOL bInheritHandle; } SECURITY_ATTRIBUTES;
+typedef struct { LONG volatile l; } SRWLOCK_; typedef struct { void *Ptr; } SRWLOCK, CONDITION_VARIABLE;
+typedef struct { ULONG_PTR Internal, InternalHigh; DWORD Offset, OffsetHigh; HANDLE hEvent; } OVERLAPPED;
+typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(LPVOID);
+typedef BOOL (CALLBACK *WNDENUMPROC)(HWND, LPARAM);
+typedef BOOL (CALLBACK *MONITORENUMPROC)(HMONITOR, HDC, LPRECT, LPARAM);
+typedef void (CALLBACK *WINEVENTPROC)(HWINEVENTHOOK, DWORD, HWND, LONG, LONG, DWORD, DWORD);
+typedef void (CALLBACK *TIMERPROC)(HWND, UINT, UINT_PTR, DWORD);
+#define TRUE 1
+#define FALSE 0
+#define S_OK 0
+#define FAILED(h) ((h) < 0)
+#define SUCCEEDED(h) ((h) >= 0)
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+#define WAIT_OBJECT_0 0
+#define WAIT_TIMEOUT 258
+#define WAIT_FAILED 0xFFFFFFFF
+#define WAIT_IO_COMPLETION 0xC0
+#define MAXIMUM_WAIT_OBJECTS 64
+#define QS_ALLINPUT 0x04FF
+#define MWMO_INPUTAVAILABLE 0x4
+#define MWMO_ALERTABLE 0x2
+#define PM_REMOVE 1
+#define PM_NOREMOVE 0
+#define WM_NULL 0
+#define WM_CREATE 1
+#define WM_DESTROY 2
+#define WM_SIZE 5
+#define WM_PAINT 0xF
+#define WM_CLOSE 0x10
+#define WM_QUIT 0x12
+#define WM_ERASEBKGND 0x14
+#define WM_SETTINGCHANGE 0x1A
+#define WM_DISPLAYCHANGE 0x7E
+#define WM_TIMER 0x113
+#define WM_LBUTTONDOWN 0x201
+#define WM_RBUTTONDOWN 0x204
+#define WM_MBUTTONDOWN 0x207
+#define WM_HOTKEY 0x312
+#define WM_DEVICECHANGE 0x219
+#define WM_DPICHANGED 0x2E0
+#define WM_USER 0x400
+#define WM_APP 0x8000
+#define HWND_TOP ((HWND)0)
+#define HWND_TOPMOST ((HWND)-1)
+#define HWND_NOTOPMOST ((HWND)-2)
+#define HWND_MESSAGE ((HWND)-3)
+#define SWP_NOSIZE 1
+#define SWP_NOMOVE 2
+#define SWP_NOZORDER 4
+#define SWP_NOREDRAW 8
+#define SWP_NOACTIVATE 0x10
+#define SWP_FRAMECHANGED 0x20
+#define SWP_SHOWWINDOW 0x40
+#define SWP_HIDEWINDOW 0x80
+#define SWP_NOOWNERZORDER 0x200
+#define SWP_NOSENDCHANGING 0x400
+#define SWP_ASYNCWINDOWPOS 0x4000
+#define SW_RESTORE 9
+#define SW_SHOWDEFAULT 10
+#define GWL_STYLE (-16)
+#define GWL_EXSTYLE (-20)
+#define GW_OWNER 4
+#define WS_CHILD 0x40000000L
+#define WS_CAPTION 0xC00000L
+#define WS_DISABLED 0x8000000L
+#define WS_MINIMIZEBOX 0x20000L
+#define WS_MAXIMIZEBOX 0x10000L
+#define WS_POPUP 0x80000000L
+#define WS_CLIPCHILDREN 0x2000000L
+#define WS_CLIPSIBLINGS 0x4000000L
+#define WS_VISIBLE 0x10000000L
+#define WS_EX_TOOLWINDOW 0x80L
+#define WS_EX_APPWINDOW 0x40000L
+#define WS_EX_NOACTIVATE 0x8000000L
+#define MOD_ALT 1
+#define MOD_CONTROL 2
+#define MOD_SHIFT 4
+#define MOD_WIN 8
+#define VK_RETURN 0x0D
+#define VK_SHIFT 0x10
+#define VK_MENU 0x12
+#define VK_SPACE 0x20
+#define VK_TAB 0x09
+#define VK_OEM_PERIOD 0xBE
+#define VK_OEM_COMMA 0xBC
+#define HSHELL_WINDOWCREATED 1
+#define HSHELL_WINDOWDESTROYED 2
+#define HSHELL_WINDOWACTIVATED 4
+#define HSHELL_REDRAW 6
+#define HSHELL_RUDEAPPACTIVATED 0x8004
+#define OBJID_WINDOW 0
+#define CHILDID_SELF 0
+#define WINEVENT_OUTOFCONTEXT 0
+#define WINEVENT_SKIPOWNPROCESS 2
+#define EVENT_MIN 1
+#define EVENT_SYSTEM_FOREGROUND 3
+#define EVENT_SYSTEM_MOVESIZESTART 0xA
+#define EVENT_SYSTEM_MOVESIZEEND 0xB
+#define EVENT_SYSTEM_MINIMIZESTART 0x16
+#define EVENT_SYSTEM_MINIMIZEEND 0x17
+#define EVENT_OBJECT_CREATE 0x8000
+#define EVENT_OBJECT_DESTROY 0x8001
+#define EVENT_OBJECT_SHOW 0x8002
+#define EVENT_OBJECT_HIDE 0x8003
+#define EVENT_OBJECT_REORDER 0x8004
+#define EVENT_OBJECT_FOCUS 0x8005
+#define EVENT_OBJECT_STATECHANGE 0x800A
+#define EVENT_OBJECT_LOCATIONCHANGE 0x800B
+#define EVENT_OBJECT_NAMECHANGE 0x800C
+#define MONITOR_DEFAULTTONEAREST 2
+#define MONITOR_DEFAULTTONULL 0
+#define COLOR_ACTIVEBORDER 10
+#define COLOR_INACTIVEBORDER 11
+#define PS_SOLID 0
+#define TRANSPARENT 1
+#define DT_CENTER 1
+#define DT_VCENTER 4
+#define DT_SINGLELINE 0x20
+#define DT_END_ELLIPSIS 0x8000
+#define DT_NOPREFIX 0x800
+#define SYSTEM_FONT 13
+#define SRCCOPY 0xCC0020
+#define BI_RGB 0
+#define DIB_RGB_COLORS 0
+#define SPI_SETACTIVEWINDOWTRACKING 0x1001
+#define SPI_SETACTIVEWNDTRKTIMEOUT 0x2003
+#define SPIF_UPDATEINIFILE 1
+#define SPIF_SENDCHANGE 2
+#define SM_XVIRTUALSCREEN 76
+#define SM_YVIRTUALSCREEN 77
+#define SM_CXVIRTUALSCREEN 78
+#define SM_CYVIRTUALSCREEN 79
+#define MB_OK 0
+#define MB_ICONERROR 0x10
+#define MB_ICONINFORMATION 0x40
+#define MB_SETFOREGROUND 0x10000
+#define PROCESS_QUERY_INFORMATION 0x400
+#define PROCESS_QUERY_LIMITED_INFORMATION 0x1000
+#define SYNCHRONIZE 0x100000
+#define IDC_ARROW ((LPCWSTR)32512)
+#define ERROR_ALREADY_EXISTS 183
+#define ERROR_PIPE_CONNECTED 535
+#define ERROR_IO_PENDING 997
+#define ERROR_MORE_DATA 234
+#define ERROR_BROKEN_PIPE 109
+#define GENERIC_READ 0x80000000
+#define GENERIC_WRITE 0x40000000
+#define FILE_SHARE_READ 1
+#define FILE_SHARE_WRITE 2
+#define OPEN_EXISTING 3
+#define FILE_BEGIN 0
+#define CREATE_ALWAYS 2
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define PIPE_ACCESS_DUPLEX 3
+#define PIPE_ACCESS_INBOUND 1
+#define PIPE_TYPE_MESSAGE 4
+#define PIPE_READMODE_MESSAGE 2
+#define PIPE_TYPE_BYTE 0
+#define PIPE_READMODE_BYTE 0
+#define PIPE_WAIT 0
+#define PIPE_REJECT_REMOTE_CLIENTS 8
+#define PIPE_UNLIMITED_INSTANCES 255
+#define FILE_FLAG_OVERLAPPED 0x40000000
+#define FILE_FLAG_FIRST_PIPE_INSTANCE 0x00080000
+#define SMTO_ABORTIFHUNG 2
+#define SMTO_BLOCK 1
+#define WM_GETTEXT 0xD
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_RELEASE 0x8000
+#define PAGE_READWRITE 4
+#define MAKEPOINTS(l) ((POINTS){ (SHORT)LOWORD(l), (SHORT)HIWORD(l) })
+#define LOWORD(l) ((WORD)((DWORD_PTR)(l) & 0xffff))
+#define HIWORD(l) ((WORD)(((DWORD_PTR)(l) >> 16) & 0xffff))
+#define RGB(r,g,b) ((COLORREF)(((BYTE)(r)|((WORD)((BYTE)(g))<<8))|(((DWORD)(BYTE)(b))<<16)))
+#define GetRValue(c) ((BYTE)(c))
+#define GetGValue(c) ((BYTE)((c)>>8))
+#define GetBValue(c) ((BYTE)((c)>>16))
+#define GetWindowLong GetWindowLongW
+#define PostMessage PostMessageW
+#define DefWindowProc DefWindowProcW
+#define DispatchMessage DispatchMessageW
+#define PeekMessage PeekMessageW
+#define LoadCursor LoadCursorW
+#define SetWindowLongPtr SetWindowLongPtrW
+#define CreateFile CreateFileW
+#define CreateEvent CreateEventW
+LONG GetWindowLongW(HWND, int); BOOL PostMessageW(HWND, UINT, WPARAM, LPARAM); LRESULT DefWindowProcW(HWND, UINT, WPARAM, LPARAM);
+BOOL PeekMessageW(LPMSG, HWND, UINT, UINT, UINT); LRESULT DispatchMessageW(const MSG *); BOOL TranslateMessage(const MSG *);
+HCURSOR LoadCursorW(HINSTANCE, LPCWSTR);
+HDC GetWindowDC(HWND); HDC GetDC(HWND); int ReleaseDC(HWND, HDC); BOOL KillTimer(HWND, UINT_PTR); UINT_PTR SetTimer(HWND, UINT_PTR, UINT, TIMERPROC);
+BOOL UnregisterHotKey(HWND, int); BOOL RegisterHotKey(HWND, int, UINT, UINT); BOOL DeregisterShellHookWindow(HWND); BOOL RegisterShellHookWindow(HWND);
+BOOL UnhookWinEvent(HWINEVENTHOOK); HWINEVENTHOOK SetWinEventHook(DWORD, DWORD, HMODULE, WINEVENTPROC, DWORD, DWORD, DWORD);
+BOOL SetSysColors(int, const int *, const COLORREF *); DWORD GetSysColor(int); BOOL DestroyWindow(HWND); HWND FindWindowW(LPCWSTR, LPCWSTR);
+BOOL DeleteObject(HGDIOBJ); HGDIOBJ SelectObject(HDC, HGDIOBJ); HBRUSH CreateSolidBrush(COLORREF); HPEN CreatePen(int, int, COLORREF);
+int FillRect(HDC, const RECT *, HBRUSH); int SetBkMode(HDC, int); COLORREF SetTextColor(HDC, COLORREF);
+HFONT CreateFontW(int, int, int, int, int, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, LPCWSTR); HGDIOBJ GetStockObject(int);
+int DrawTextW(HDC, LPCWSTR, int, LPRECT, UINT); BOOL GetTextExtentPoint32W(HDC, LPCWSTR, int, SIZE *);
+HDC CreateCompatibleDC(HDC); BOOL DeleteDC(HDC); HBITMAP CreateDIBSection(HDC, const BITMAPINFO *, UINT, void **, HANDLE, DWORD);
+BOOL BitBlt(HDC, int, int, int, int, HDC, int, int, DWORD);
+HDC BeginPaint(HWND, PAINTSTRUCT *); BOOL EndPaint(HWND, const PAINTSTRUCT *);
+void OutputDebugStringW(LPCWSTR); int MessageBoxW(HWND, LPCWSTR, LPCWSTR, UINT); int _vscwprintf(const wchar_t *, va_list); int wcscpy_s(wchar_t *, size_t, const wchar_t *);
+int _snwprintf(wchar_t *, size_t, const wchar_t *, ...);
+BOOL SetForegroundWindow(HWND); BOOL EnumWindows(WNDENUMPROC, LPARAM);
+int GetClassNameW(HWND, LPWSTR, int); int InternalGetWindowText(HWND, LPWSTR, int);
+HWND GetWindow(HWND, UINT); HWND GetDesktopWindow(void); HWND GetParent(HWND);
+BOOL IsWindowVisible(HWND); BOOL IsWindow(HWND); BOOL GetWindowRect(HWND, LPRECT); BOOL GetWindowInfo(HWND, WINDOWINFO *);
+BOOL SetWindowPlacement(HWND, const WINDOWPLACEMENT *); BOOL SetWindowPos(HWND, HWND, int, int, int, int, UINT);
+HDWP BeginDeferWindowPos(int); HDWP DeferWindowPos(HDWP, HWND, HWND, int, int, int, int, UINT); BOOL EndDeferWindowPos(HDWP);
+DWORD GetWindowThreadProcessId(HWND, LPDWORD); HANDLE OpenProcess(DWORD, BOOL, DWORD); BOOL CloseHandle(HANDLE);
+BOOL QueryFullProcessImageNameW(HANDLE, DWORD, LPWSTR, LPDWORD); BOOL GetProcessTimes(HANDLE, FILETIME *, FILETIME *, FILETIME *, FILETIME *);
+SHORT GetKeyState(int); BOOL GetCursorPos(LPPOINT); HMONITOR MonitorFromWindow(HWND, DWORD); HMONITOR MonitorFromPoint(POINT, DWORD);
+BOOL GetMonitorInfoW(HMONITOR, MONITORINFO *); BOOL EnumDisplayMonitors(HDC, LPCRECT, MONITORENUMPROC, LPARAM);
+BOOL SystemParametersInfoW(UINT, UINT, void *, UINT); int GetSystemMetrics(int); void PostQuitMessage(int);
+unsigned short RegisterClassExW(const WNDCLASSEXW *); unsigned short RegisterClassW(const WNDCLASSW *);
+HWND CreateWindowExW(DWORD, LPCWSTR, LPCWSTR, DWORD, int, int, int, int, HWND, HMENU, HINSTANCE, LPVOID);
+UINT RegisterWindowMessageW(LPCWSTR); BOOL SetProcessDPIAware(void); HANDLE CreateMutexW(SECURITY_ATTRIBUTES *, BOOL, LPCWSTR); DWORD GetLastError(void);
+BOOL QueryPerformanceCounter(LARGE_INTEGER *); BOOL QueryPerformanceFrequency(LARGE_INTEGER *); DWORD GetTickCount(void); ULONGLONG GetTickCount64(void);
+HANDLE CreateThread(SECURITY_ATTRIBUTES *, size_t, LPTHREAD_START_ROUTINE, LPVOID, DWORD, LPDWORD);
+HANDLE CreateEventW(SECURITY_ATTRIBUTES *, BOOL, BOOL, LPCWSTR); BOOL SetEvent(HANDLE);
+DWORD WaitForSingleObject(HANDLE, DWORD); DWORD WaitForMultipleObjects(DWORD, const HANDLE *, BOOL, DWORD);
+DWORD MsgWaitForMultipleObjectsEx(DWORD, const HANDLE *, DWORD, DWORD, DWORD);
+void InitializeSRWLock(SRWLOCK *); void AcquireSRWLockExclusive(SRWLOCK *); void ReleaseSRWLockExclusive(SRWLOCK *);
+void InitializeConditionVariable(CONDITION_VARIABLE *); BOOL SleepConditionVariableSRW(CONDITION_VARIABLE *, SRWLOCK *, DWORD, ULONG_PTR); void WakeConditionVariable(CONDITION_VARIABLE *); void WakeAllConditionVariable(CONDITION_VARIABLE *);
+void Sleep(DWORD);
+HANDLE CreateFileW(LPCWSTR, DWORD, DWORD, SECURITY_ATTRIBUTES *, DWORD, DWORD, HANDLE); BOOL ReadFile(HANDLE, LPVOID, DWORD, LPDWORD, OVERLAPPED *); BOOL WriteFile(HANDLE, LPCVOID, DWORD, LPDWORD, OVERLAPPED *);
+BOOL FlushFileBuffers(HANDLE); BOOL CancelSynchronousIo(HANDLE);
+BOOL GetFileSizeEx(HANDLE, LARGE_INTEGER *); BOOL SetFilePointerEx(HANDLE, LARGE_INTEGER, LARGE_INTEGER *, DWORD);
+HANDLE CreateNamedPipeW(LPCWSTR, DWORD, DWORD, DWORD, DWORD, DWORD, DWORD, SECURITY_ATTRIBUTES *); BOOL ConnectNamedPipe(HANDLE, OVERLAPPED *); BOOL DisconnectNamedPipe(HANDLE);
+int MultiByteToWideChar(UINT, DWORD, LPCSTR, int, LPWSTR, int); int WideCharToMultiByte(UINT, DWORD, LPCWSTR, int, LPSTR, int, LPCSTR, BOOL *);
+#define CP_UTF8 65001
+LPVOID VirtualAlloc(LPVOID, size_t, DWORD, DWORD); BOOL VirtualFree(LPVOID, size_t, DWORD);
+#define IsWindowVisible IsWindowVisible
+#include <stdio.h>
+FILE *_wfopen(const wchar_t *, const wchar_t *);
+LPWSTR *CommandLineToArgvW(LPCWSTR, int *); LPWSTR GetCommandLineW(void); typedef void *HLOCAL; HLOCAL LocalFree(HLOCAL);
+LRESULT SendMessage(HWND, UINT, WPARAM, LPARAM);
+DWORD MsgWaitForMultipleObjects(DWORD, const HANDLE *, BOOL, DWORD, DWORD);
+#define QS_SENDMESSAGE 0x40
+#define PM_QS_SENDMESSAGE (QS_SENDMESSAGE << 16)
+#define PM_NOREMOVE 0
+typedef struct { DWORD dmSize; DWORD dmDisplayFrequency; } DEVMODEW;
+#define ENUM_CURRENT_SETTINGS ((DWORD)-1)
+BOOL EnumDisplaySettingsW(LPCWSTR, DWORD, DEVMODEW *);
+typedef struct { DWORD dwFileAttributes; FILETIME ftCreationTime, ftLastAccessTime, ftLastWriteTime; DWORD nFileSizeHigh, nFileSizeLow; } WIN32_FILE_ATTRIBUTE_DATA;
+typedef enum { GetFileExInfoStandard } GET_FILEEX_INFO_LEVELS;
+BOOL GetFileAttributesExW(LPCWSTR, GET_FILEEX_INFO_LEVELS, void *);
+LONG CompareFileTime(const FILETIME *, const FILETIME *);
+#define DT_LEFT 0
+#define FILE_SHARE_DELETE 4
+void SetLastError(DWORD);
+#define ERROR_INSUFFICIENT_BUFFER 122
@@ -0,0 +1,3 @@
+/* See LICENSE file for copyright and license details.
+ * Host build stand-in, see windows.h. */
+#pragma once
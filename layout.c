@@ -0,0 +1,181 @@
+/* See LICENSE file for copyright and license details. */
+
+#include "layout.h"
+
+static void fibonacci(const LayoutParams *p, Rect *r, int s);
+
+void
+layoutrects(LayoutFunc f, const LayoutParams *p, Rect *r) {
+    LayoutParams q = *p;
+    int half = p->gap / 2, outer = p->gap - half;
+    unsigned int i;
+
+    if (!f || !p->n)
+        return;
+    q.area.x += outer;
+    q.area.y += outer;
+    q.area.w -= 2 * outer;
+    q.area.h -= 2 * outer;
+    f(&q, r);
+    for (i = 0; i < p->n; i++) {
+        r[i].x += half;
+        r[i].y += half;
+        r[i].w -= 2 * (half + p->bw);
+        r[i].h -= 2 * (half + p->bw);
+    }
+}
+
+void
+tile(const LayoutParams *p, Rect *r) {
+    const Rect *a = &p->area;
+    unsigned int i, n = p->n;
+    int mw, x, y, w, h;
+
+    mw = (n == 1) ? a->w : (int)(p->mfact * a->w);
+    r[0] = (Rect){ a->x, a->y, mw, a->h };
+    if (--n == 0)
+        return;
+
+    x = a->x + mw;
+    y = a->y;
+    w = a->w - mw;
+    h = a->h / n;
+    for (i = 0; i < n; i++, y += h)
+        r[i + 1] = (Rect){ x, y, w, (i + 1 == n) ? a->y + a->h - y : h };
+}
+
+void
+monocle(const LayoutParams *p, Rect *r) {
+    for (unsigned int i = 0; i < p->n; i++)
+        r[i] = p->area;
+}
+
+void
+bstack(const LayoutParams *p, Rect *r) {
+    const Rect *a = &p->area;
+    unsigned int i, n = p->n;
+    int mh, x, y, w, h;
+
+    mh = (int)(p->mfact * a->h);
+    r[0] = (Rect){ a->x, a->y, a->w, (n == 1) ? a->h : mh };
+    if (--n == 0)
+        return;
+
+    x = a->x;
+    y = a->y + mh;
+    w = a->w / n;
+    h = a->h - mh;
+    if (h < p->minh) {
+        y = a->y;
+        h = a->h;
+    }
+    for (i = 0; i < n; i++, x += w)
+        r[i + 1] = (Rect){ x, y, (i + 1 == n) ? a->x + a->w - x : w, h };
+}
+
+void
+gaplessgrid(const LayoutParams *p, Rect *r) {
+    const Rect *a = &p->area;
+    unsigned int i, n = p->n, cols, rows;
+    int cw, ch, cn = 0, rn = 0;
+
+    for (cols = 0; cols <= n / 2; cols++)
+        if (cols * cols >= n)
+            break;
+    if (n == 5) /* 2 columns of 2 and 3 rather than 3 columns of 1, 2 and 2 */
+        cols = 2;
+    rows = n / cols;
+    cw = a->w / cols;
+    ch = a->h / rows;
+
+    for (i = 0; i < n; i++) {
+        /* the last n % cols columns have an extra row */
+        if (rn == 0 && cn + 1 > (int)(cols - n % cols) && rows == n / cols) {
+            rows++;
+            ch = a->h / rows;
+        }
+        r[i] = (Rect){ a->x + cn * cw, a->y + rn * ch, cw, ch };
+        if (++rn >= (int)rows) {
+            rn = 0;
+            cn++;
+        }
+    }
+}
+
+void
+grid(const LayoutParams *p, Rect *r) {
+    const Rect *a = &p->area;
+    unsigned int i, n = p->n, cols, rows, cn = 0, rn = 0;
+    int cw, ch, aw, ah;
+
+    for (rows = 0; rows <= n / 2; rows++)
+        if (rows * rows >= n)
+            break;
+    cols = (rows && (rows - 1) * rows >= n) ? rows - 1 : rows;
+    ch = a->h / rows;
+    cw = a->w / cols;
+
+    for (i = 0; i < n; i++) {
+        /* the last row and column take up the rounding */
+        ah = (rn + 1 == rows) ? a->h - ch * (int)rows : 0;
+        aw = (cn + 1 == cols) ? a->w - cw * (int)cols : 0;
+        r[i] = (Rect){ a->x + (int)cn * cw, a->y + (int)rn * ch, cw + aw, ch + ah };
+        if (++rn == rows) {
+            rn = 0;
+            cn++;
+        }
+    }
+}
+
+/* Each window takes half of what the previous one left, turning clockwise
+ * for spiral (s = 0) or down and right for dwindle (s = 1). */
+static void
+fibonacci(const LayoutParams *p, Rect *r, int s) {
+    const Rect *a = &p->area;
+    unsigned int i, j, n = p->n;
+    int nx = a->x, ny = a->y, nw = a->w, nh = a->h;
+
+    for (i = j = 0; j < n; j++) {
+        /* stop splitting once the halves would be all border */
+        if ((i % 2 && nh / 2 > 2 * p->bw) || (!(i % 2) && nw / 2 > 2 * p->bw)) {
+            if (i < n - 1) {
+                if (i % 2)
+                    nh /= 2;
+                else
+                    nw /= 2;
+                if ((i % 4) == 2 && !s)
+                    nx += nw;
+                else if ((i % 4) == 3 && !s)
+                    ny += nh;
+            }
+            if ((i % 4) == 0)
+                ny += s ? nh : -nh;
+            else if ((i % 4) == 1)
+                nx += nw;
+            else if ((i % 4) == 2)
+                ny += nh;
+            else
+                nx += s ? nw : -nw;
+
+            if (i == 0) {
+                if (n != 1)
+                    nw = (int)(a->w * p->mfact);
+                ny = a->y;
+            } else if (i == 1) {
+                nw = a->w - nw;
+            }
+            i++;
+        }
+        r[j] = (Rect){ nx, ny, nw, nh };
+    }
+}
+
+void
+spiral(const LayoutParams *p, Rect *r) {
+    fibonacci(p, r, 0);
+}
+
+void
+dwindle(const LayoutParams *p, Rect *r) {
+    fibonacci(p, r, 1);
+}
@@ -0,0 +1,35 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Layouts are plain arithmetic on rectangles: given the work area of a
+ * monitor and the number of tiled windows, a layout fills in one rectangle
+ * per window, in tiling order. Nothing in here knows about windows, so it
+ * builds and runs anywhere.
+ */
+
+typedef struct {
+    int x, y, w, h;
+} Rect;
+
+typedef struct {
+    Rect area;          /* work area of the monitor */
+    unsigned int n;     /* number of tiled windows, r[] has room for n */
+    float mfact;        /* share of the master area */
+    int bw;             /* border width of the windows */
+    int gap;            /* space between windows and around the area */
+    int minh;           /* stack rows lower than this use the whole height */
+} LayoutParams;
+
+typedef void (*LayoutFunc)(const LayoutParams *p, Rect *r);
+
+/* Runs f on the area less the outer gap, then shrinks the cells by the
+ * inner gap and the borders, so r[] holds what a window is resized to. */
+void layoutrects(LayoutFunc f, const LayoutParams *p, Rect *r);
+
+/* layouts, they fill r[] with the outer cell of each window */
+void tile(const LayoutParams *p, Rect *r);
+void monocle(const LayoutParams *p, Rect *r);
+void bstack(const LayoutParams *p, Rect *r);
+void gaplessgrid(const LayoutParams *p, Rect *r);
+void grid(const LayoutParams *p, Rect *r);
+void spiral(const LayoutParams *p, Rect *r);
+void dwindle(const LayoutParams *p, Rect *r);
@@ -0,0 +1,243 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Runs dwm-win32 headless on the fake desktop: windows are opened, clicked
+ * and closed, and after each step what the window manager believes is
+ * compared with where the windows actually are.
+ */
+#include "../dwm-win32.c"
+#include "../host/fakedesktop.h"
+
+static unsigned int failures;
+
+#define CHECK(x) do { if (!(x)) { \
+    fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, step, #x); \
+    failures++; } } while (0)
+
+static const char *step = "setup";
+
+static unsigned int
+nclients(void) {
+    unsigned int n = 0;
+
+    for (Monitor *m = mons; m; m = m->next)
+        for (Client *c = m->clients; c; c = c->next)
+            n++;
+    return n;
+}
+
+static bool
+overlap(const Client *a, const Client *b) {
+    return a->x < b->x + b->w && b->x < a->x + a->w
+        && a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+/* The invariants that hold whenever dwm-win32 is idle. */
+static void
+checkdesktop(void) {
+    RECT in;
+
+    for (Monitor *m = mons; m; m = m->next) {
+        for (Client *c = m->clients; c; c = c->next) {
+            FakeWindow *w = fakew(c->hwnd);
+
+            CHECK(w && w->alive);
+            if (!w)
+                continue;
+            CHECK(w->visible == ISVISIBLE(c));
+            if (!ISVISIBLE(c) || c->isfloating || c->isminimized)
+                continue;
+            /* the visible frame is where the layout put it */
+            in = (w->style & WS_CAPTION) ? fake.insets : (RECT){ 0, 0, 0, 0 };
+            CHECK(w->rect.left + in.left == c->x && w->rect.top + in.top == c->y);
+            CHECK(w->rect.right - in.right == c->x + c->w && w->rect.bottom - in.bottom == c->y + c->h);
+            CHECK(c->x >= m->wx && c->y >= m->wy);
+            CHECK(c->x + c->w <= m->wx + m->ww && c->y + c->h <= m->wy + m->wh);
+            for (Client *o = c->next; o; o = o->next)
+                if (ISVISIBLE(o) && !o->isfloating && !o->isminimized)
+                    CHECK(!overlap(c, o));
+        }
+    }
+    if (sel) {
+        CHECK(ISVISIBLE(sel));
+        CHECK(fake.foreground == sel->hwnd);
+    }
+}
+
+int
+main(void) {
+    HWND editor, term, browser, mail, tool, child;
+    Arg a;
+
+    fakemonitor(0, 0, 1920, 1080);
+    fake.insets = (RECT){ 7, 0, 7, 7 };
+    editor = fakewindow(L"Notepad", L"notes.txt - Notepad", L"C:\\Windows\\notepad.exe", 100,
+                        (RECT){ 200, 200, 900, 700 });
+    fakestart();
+    CHECK(nclients() == 1);
+    CHECK(sel && sel->hwnd == editor);
+    checkdesktop();
+
+    step = "manage";
+    term = fakeopen(L"ConsoleWindowClass", L"cmd.exe", L"C:\\Windows\\System32\\conhost.exe", 200);
+    browser = fakeopen(L"Chrome_WidgetWin_1", L"New Tab", L"C:\\chrome.exe", 300);
+    mail = fakeopen(L"rctrl_renwnd32", L"Inbox", L"C:\\outlook.exe", 400);
+    fakesettle();
+    CHECK(nclients() == 4);
+    CHECK(getclient(term) && getclient(browser) && getclient(mail));
+    CHECK(getclient(mail)->processname && wcsstr(getclient(mail)->processname, L"outlook.exe"));
+    checkdesktop();
+
+    step = "ignored";
+    tool = fakewindow(L"Tooltip", L"tip", NULL, 300, (RECT){ 0, 0, 50, 20 });
+    fakew(tool)->exstyle = WS_EX_TOOLWINDOW;
+    child = fakewindow(L"Button", L"OK", NULL, 300, (RECT){ 0, 0, 50, 20 });
+    fakew(child)->style |= WS_CHILD;
+    fakew(child)->parent = browser;
+    fakeevent(EVENT_OBJECT_SHOW, tool);
+    fakeevent(EVENT_OBJECT_CREATE, child);
+    fakesettle();
+    CHECK(!getclient(tool) && !getclient(child));
+    CHECK(nclients() == 4);
+    checkdesktop();
+
+    step = "floating";
+    {
+        HWND dialog = fakewindow(L"#32770", L"Save As", L"C:\\chrome.exe", 300, (RECT){ 300, 200, 800, 600 });
+        unsigned long asked = fake.framequeries, opened = fake.imagequeries;
+
+        fakew(dialog)->style = WS_CAPTION;
+        fakeevent(EVENT_OBJECT_CREATE, dialog);
+        processevents();
+        /* the UI thread leaves DWM to the workers */
+        CHECK(getclient(dialog) && getclient(dialog)->isfloating);
+        CHECK(fake.framequeries == asked);
+        fakequeries();
+        CHECK(fake.framequeries == asked + 1);
+        /* the browser is known, its second window shares its process */
+        CHECK(getclient(dialog)->proc == getclient(browser)->proc);
+        CHECK(fake.imagequeries == opened);
+        fakedestroy(dialog);
+        fakesettle();
+    }
+    checkdesktop();
+
+    step = "focus";
+    fakeactivate(term);
+    fakesettle();
+    CHECK(sel && sel->hwnd == term);
+    checkdesktop();
+    focusstack(&(Arg){ .i = +1 });
+    CHECK(sel && sel->hwnd != term);
+    checkdesktop();
+
+    step = "zoom";
+    fakeactivate(browser);
+    fakesettle();
+    zoom(NULL);
+    CHECK(nexttiled(selmon->clients) && nexttiled(selmon->clients)->hwnd == browser);
+    checkdesktop();
+
+    step = "tags";
+    a.ui = 1 << 1;
+    tag(&a);
+    CHECK(!ISVISIBLE(getclient(browser)));
+    CHECK(!fakew(browser)->visible);
+    checkdesktop();
+    view(&a);
+    CHECK(ISVISIBLE(getclient(browser)));
+    CHECK(sel && sel->hwnd == browser);
+    checkdesktop();
+    a.ui = 1 << 0;
+    view(&a);
+    CHECK(nclients() == 4);
+    checkdesktop();
+
+    step = "layout";
+    setlayout(&(Arg){ .v = &layouts[1] });
+    checkdesktop();
+    setlayout(&(Arg){ .v = &layouts[0] });
+    setmfact(&(Arg){ .f = 1.70 });
+    checkdesktop();
+
+    step = "commands";
+    fakeactivate(term);
+    fakesettle();
+    {
+        char in[] = "@class=Notepad zoom";
+        Command cmd = { in };
+
+        runcommands(&cmd);
+        CHECK(!strncmp(cmd.out, "ok 1", 4));
+    }
+    /* zoom focused its target, that selection must stick */
+    CHECK(sel && sel->hwnd == editor);
+    CHECK(nexttiled(selmon->clients)->hwnd == editor);
+    checkdesktop();
+
+    step = "status";
+    setstatus(L"^scpu^n 5% ^x ^^ 7^");
+    CHECK(!wcscmp(stext, L"cpu 5% ^x ^ 7^"));
+    CHECK(stextcol[0] == StatusSel && stextcol[3] == StatusNorm);
+    {
+        char line[1024];
+
+        /* cut at the last whole character that fits */
+        memset(line, 'a', 254);
+        strcpy(line + 254, "\xc3\xa9\xc3\xa9");
+        publishstatus(line);
+        CHECK(wcslen(feed.text) == 255 && feed.text[254] == 0xe9);
+        memset(line, 'b', sizeof(line) - 1);
+        line[sizeof(line) - 1] = '\0';
+        line[255] = '\xc3';
+        line[256] = '\xa9';
+        publishstatus(line);
+        CHECK(wcslen(feed.text) == 255 && feed.text[0] == L'b');
+    }
+
+    step = "minimize";
+    fakeactivate(term);
+    fakesettle();
+    fakeevent(EVENT_SYSTEM_MINIMIZESTART, term);
+    fakesettle();
+    CHECK(sel && sel->hwnd != term);
+    for (Client *c = nexttiled(selmon->clients); c; c = nexttiled(c->next))
+        CHECK(c->hwnd != term);
+    checkdesktop();
+    fakeevent(EVENT_SYSTEM_MINIMIZEEND, term);
+    fakesettle();
+    CHECK(nexttiled(selmon->clients)->hwnd == term);
+    checkdesktop();
+
+    step = "unmanage";
+    fakeactivate(term);
+    fakesettle();
+    fakedestroy(term);
+    fakesettle();
+    CHECK(!getclient(term));
+    CHECK(nclients() == 3);
+    CHECK(sel && sel->hwnd != term);
+    checkdesktop();
+    fakedestroy(editor);
+    fakedestroy(mail);
+    fakesettle();
+    CHECK(nclients() == 1);
+    checkdesktop();
+
+    /* no more than the stack fits at the minimum height of a window */
+    step = "storm";
+    for (unsigned int i = 0; i < 40; i++)
+        fakeopen(L"Storm", L"storm", L"C:\\storm.exe", 1000 + i % 7);
+    fakesettle();
+    CHECK(nclients() == 41);
+    checkdesktop();
+    for (unsigned int i = 0; i < fake.n; i++)
+        if (fake.w[i].alive && !wcscmp(fake.w[i].classname, L"Storm") && i % 2)
+            fakedestroy(fakehwnd(i));
+    fakesettle();
+    CHECK(nclients() == 21);
+    checkdesktop();
+
+    cleanup();
+    printf("desktoptest: %s\n", failures ? "FAIL" : "ok");
+    return failures != 0;
+}
@@ -0,0 +1,318 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Random steps on two monitors, checked after each one against arrays that
+ * model the tiling and focus order of each monitor. First the list
+ * primitives alone, attach(), detach(), attachstack(), detachstack() and
+ * swap(). Then windows opened, closed and activated on the fake desktop,
+ * with zoom(), movestack(), sendmon() and focusmon() in between, where the
+ * model also knows which client is selected on which monitor.
+ */
+#include "../dwm-win32.c"
+#include "../host/fakedesktop.h"
+
+#define NMONS       2
+#define NCLIENTS    64
+#define STEPS       2000000
+#define OPSTEPS     50000
+#define MAXOPEN     24
+
+typedef struct {
+    Client *c[NCLIENTS];
+    unsigned int n;
+} Model;
+
+static Monitor lmons[NMONS];
+static Client lclients[NCLIENTS];
+static Model tiled[NMONS], focused[NMONS];
+static bool intiled[NCLIENTS], instack[NCLIENTS];
+static unsigned int rng = 1;
+static Monitor *mon[NMONS];     /* of the fake desktop, in mons order */
+static Client *msel;            /* selection the model expects */
+static unsigned int mselmon;
+
+static unsigned int
+xorshift(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static void
+modelinsert(Model *m, Client *c) {
+    memmove(&m->c[1], &m->c[0], m->n++ * sizeof(Client *));
+    m->c[0] = c;
+}
+
+static void
+modelremove(Model *m, Client *c) {
+    unsigned int i;
+
+    for (i = 0; m->c[i] != c; i++);
+    memmove(&m->c[i], &m->c[i + 1], (--m->n - i) * sizeof(Client *));
+}
+
+static unsigned int
+modelindex(const Model *m, const Client *c) {
+    unsigned int i;
+
+    for (i = 0; m->c[i] != c; i++);
+    return i;
+}
+
+/* The list must hold the model's clients in its order, linked both ways. */
+static bool
+checklist(const Model *m, Client *head, bool stack) {
+    Client *c, *prev = NULL;
+    unsigned int i = 0;
+
+    for (c = head; c; prev = c, c = stack ? c->snext : c->next, i++)
+        if (i == m->n || c != m->c[i] || (stack ? c->sprev : c->prev) != prev)
+            return false;
+    return i == m->n;
+}
+
+static bool
+primitives(void) {
+    unsigned int step, i, k, op;
+    Client *a, *b;
+
+    for (i = 0; i < NCLIENTS; i++)
+        lclients[i].mon = &lmons[i % NMONS];
+    for (step = 0; step < STEPS; step++) {
+        k = xorshift() % NCLIENTS;
+        a = &lclients[k];
+        op = xorshift() % 3;
+        if (op == 0) {
+            if (intiled[k]) {
+                detach(a);
+                modelremove(&tiled[a->mon - lmons], a);
+            } else {
+                /* only a detached client may move to another monitor */
+                if (!instack[k])
+                    a->mon = &lmons[xorshift() % NMONS];
+                attach(a);
+                modelinsert(&tiled[a->mon - lmons], a);
+            }
+            intiled[k] = !intiled[k];
+        } else if (op == 1) {
+            if (instack[k]) {
+                detachstack(a);
+                modelremove(&focused[a->mon - lmons], a);
+            } else {
+                if (!intiled[k])
+                    a->mon = &lmons[xorshift() % NMONS];
+                attachstack(a);
+                modelinsert(&focused[a->mon - lmons], a);
+            }
+            instack[k] = !instack[k];
+        } else {
+            Model *m = &tiled[a->mon - lmons];
+
+            if (!intiled[k])
+                continue;
+            b = m->c[xorshift() % m->n];
+            i = modelindex(m, a);
+            k = modelindex(m, b);
+            swap(a, b);
+            m->c[i] = b;
+            m->c[k] = a;
+        }
+        for (i = 0; i < NMONS; i++) {
+            if (!checklist(&tiled[i], lmons[i].clients, false)
+            || !checklist(&focused[i], lmons[i].stack, true)) {
+                fprintf(stderr, "listtest: step %u: monitor %u differs from the model\n", step, i);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static unsigned int
+monindex(const Monitor *m) {
+    unsigned int i;
+
+    for (i = 0; i < NMONS && mon[i] != m; i++);
+    return i;
+}
+
+static void
+modelfront(Model *m, Client *c) {
+    modelremove(m, c);
+    modelinsert(m, c);
+}
+
+/* What setselected(NULL) picks, every client is visible here. */
+static void
+modelfocusnull(void) {
+    msel = focused[mselmon].n ? focused[mselmon].c[0] : NULL;
+}
+
+static unsigned int
+nopen(void) {
+    return tiled[0].n + tiled[1].n;
+}
+
+static void
+opwindow(unsigned int i) {
+    Monitor *m = mon[i];
+    HWND hwnd = fakewindow(L"Model", L"model", L"C:\\model.exe", 100,
+                           (RECT){ m->wx + 100, m->wy + 100, m->wx + 740, m->wy + 580 });
+    Client *c;
+
+    fakeevent(EVENT_OBJECT_CREATE, hwnd);
+    fakeevent(EVENT_OBJECT_SHOW, hwnd);
+    fakesettle();
+    if (!(c = getclient(hwnd)))
+        return;
+    modelinsert(&tiled[i], c);
+    modelinsert(&focused[i], c);
+    modelfocusnull();
+}
+
+static void
+opclose(Client *c) {
+    unsigned int i = monindex(c->mon);
+
+    modelremove(&tiled[i], c);
+    modelremove(&focused[i], c);
+    fakedestroy(c->hwnd);
+    fakesettle();
+    if (msel == c)
+        modelfocusnull();
+}
+
+static void
+opactivate(Client *c) {
+    fakeactivate(c->hwnd);
+    fakesettle();
+    mselmon = monindex(c->mon);
+    msel = c;
+    modelfront(&focused[mselmon], c);
+}
+
+static void
+opzoom(void) {
+    Model *t;
+    Client *c = msel;
+
+    zoom(NULL);
+    if (!c)
+        return;
+    t = &tiled[monindex(c->mon)];
+    if (t->c[0] == c && !(c = t->n > 1 ? t->c[1] : NULL))
+        return;
+    modelfront(t, c);
+    modelfront(&focused[monindex(c->mon)], c);
+    msel = c;
+}
+
+static void
+opmovestack(int dir) {
+    Model *t;
+    unsigned int i, k;
+
+    movestack(&(Arg){ .i = dir });
+    if (!msel)
+        return;
+    t = &tiled[monindex(msel->mon)];
+    i = modelindex(t, msel);
+    if (dir > 0)
+        k = i + 1 < t->n ? i + 1 : 0;
+    else
+        k = i > 0 ? i - 1 : t->n - 1;
+    t->c[i] = t->c[k];
+    t->c[k] = msel;
+}
+
+static void
+opsendmon(void) {
+    unsigned int from, to;
+    Client *c = msel;
+
+    if (!c) {
+        sendmon(&(Arg){ .i = +1 });
+        return;
+    }
+    from = monindex(c->mon);
+    to = (from + 1) % NMONS;
+    sendmon(&(Arg){ .i = +1 });
+    modelremove(&tiled[from], c);
+    modelremove(&focused[from], c);
+    modelinsert(&tiled[to], c);
+    modelinsert(&focused[to], c);
+    /* the move shows the window, which refocuses the selected monitor */
+    modelfocusnull();
+}
+
+static void
+opfocusmon(void) {
+    focusmon(&(Arg){ .i = +1 });
+    mselmon = (mselmon + 1) % NMONS;
+    if (focused[mselmon].n)
+        msel = focused[mselmon].c[0];
+}
+
+static bool
+operations(void) {
+    unsigned int step, i, op;
+    Client *c;
+
+    fakemonitor(0, 0, 1920, 1080);
+    fakemonitor(1920, 0, 1920, 1080);
+    fakestart();
+    for (i = 0; i < NMONS; i++) {
+        mon[i] = i ? mon[i - 1]->next : mons;
+        tiled[i].n = focused[i].n = 0;
+    }
+    mselmon = monindex(selmon);
+    msel = NULL;
+
+    for (step = 0; step < OPSTEPS; step++) {
+        i = xorshift() % NMONS;
+        c = tiled[i].n ? tiled[i].c[xorshift() % tiled[i].n] : NULL;
+        op = xorshift() % 9;
+        if (nopen() < 2 || (op == 0 && nopen() < MAXOPEN))
+            opwindow(i);
+        else if (op == 1 && c)
+            opclose(c);
+        else if (op == 2 && c)
+            opactivate(c);
+        else if (op == 3)
+            opzoom();
+        else if (op == 4)
+            opmovestack(+1);
+        else if (op == 5)
+            opmovestack(-1);
+        else if (op == 6)
+            opsendmon();
+        else if (op == 7)
+            opfocusmon();
+        else if (nopen() < MAXOPEN / 2)
+            opwindow(i);
+        else if (c)
+            opclose(c);
+        for (i = 0; i < NMONS; i++) {
+            if (!checklist(&tiled[i], mon[i]->clients, false)
+            || !checklist(&focused[i], mon[i]->stack, true)) {
+                fprintf(stderr, "listtest: operation %u (%u): monitor %u differs from the model\n", step, op, i);
+                return false;
+            }
+        }
+        if (sel != msel || selmon != mon[mselmon]) {
+            fprintf(stderr, "listtest: operation %u (%u): selection differs from the model\n", step, op);
+            return false;
+        }
+    }
+    cleanup();
+    return true;
+}
+
+int
+main(void) {
+    bool ok = primitives() && operations();
+
+    printf("listtest: %s\n", ok ? "ok" : "FAIL");
+    return !ok;
+}